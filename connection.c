@@ -30,19 +30,25 @@
  * Connection cache hash table entry
  *
  * The lookup key in this hash table is the foreign server OID plus the user
- * mapping OID.  (We use just one connection per user per foreign server,
- * so that we can ensure all scans use the same snapshot during a query.)
+ * mapping OID, and whether the connection is compressed.  Uncompressed
+ * scans share one connection per user per foreign server.  Scans that
+ * compress their traffic have a connection of their own, as compression is
+ * set up when connecting, so they do not see the same snapshot as the
+ * others when both run in one query.
  */
 typedef struct ConnCacheKey
 {
 	Oid			serverid;		/* OID of foreign server */
 	Oid			userid;			/* OID of local user whose mapping we use */
+	bool		compressed;		/* is the traffic compressed? */
 } ConnCacheKey;
 
 typedef struct ConnCacheEntry
 {
 	ConnCacheKey key;       /* hash key (must be first) */
 	MYSQL *conn;            /* connection to foreign server, or NULL */
+	MySQLFdwExecState *pending_scan;   /* scan with a fetch in flight, if any */
+	MySQLFdwExecState *streaming_scan; /* scan with a streaming result to read, if any */
 } ConnCacheEntry;
 
 /*
@@ -50,14 +56,19 @@ typedef struct ConnCacheEntry
  */
 static HTAB *ConnectionHash = NULL;
 
+static ConnCacheEntry *mysql_find_connection(MYSQL *conn);
+
 /*
  * mysql_get_connection:
  * 			Get a connection which can be used to execute queries on
  * the remote MySQL server with the user's authorization. A new connection
  * is established if we don't already have a suitable one.
+ * compress asks for a connection compressed as the compression option of
+ * the server says.
  */
 MYSQL*
-mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt)
+mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt,
+					 bool compress)
 {
 	bool found;
 	ConnCacheEntry *entry;
@@ -79,9 +90,13 @@ mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt)
 									HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
 	}
 
-	/* Create hash key for the entry.  Assume no pad bytes in key struct */
+	/* Create hash key for the entry.  Zero the pad bytes, they are hashed too */
+	if (opt->compression == MYSQL_COMPRESS_NONE)
+		compress = false;
+	MemSet(&key, 0, sizeof(key));
 	key.serverid = server->serverid;
 	key.userid = user->userid;
+	key.compressed = compress;
 
 	/*
 	 * Find or create cached entry for requested connection.
@@ -91,7 +106,14 @@ mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt)
 	{
 		/* initialize new hashtable entry (key is already filled in) */
 		entry->conn = NULL;
+		entry->pending_scan = NULL;
+		entry->streaming_scan = NULL;
 	}
+
+	/* The connection may be about to be used, it must not be busy */
+	if (entry->pending_scan != NULL || entry->streaming_scan != NULL)
+		mysql_finish_pending_fetch(entry->conn);
+
 	if (entry->conn == NULL)
 	{
 		entry->conn = mysql_connect(
@@ -106,10 +128,12 @@ mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt)
 			opt->ssl_cert,
 			opt->ssl_ca,
 			opt->ssl_capath,
-			opt->ssl_cipher
+			opt->ssl_cipher,
+			compress ? opt->compression : MYSQL_COMPRESS_NONE,
+			opt->compression_level
 		);
-		elog(DEBUG3, "new mysql_fdw connection %p for server \"%s\"",
-			 entry->conn, server->servername);
+		elog(DEBUG3, "new mysql_fdw connection %p for server \"%s\"%s",
+			 entry->conn, server->servername, compress ? " (compressed)" : "");
 	}
 	return entry->conn;
 }
@@ -136,6 +160,8 @@ mysql_cleanup_connection(void)
 		elog(DEBUG3, "disconnecting mysql_fdw connection %p", entry->conn);
 		_mysql_close(entry->conn);
 		entry->conn = NULL;
+		entry->pending_scan = NULL;
+		entry->streaming_scan = NULL;
 	}
 }
 
@@ -144,28 +170,99 @@ mysql_cleanup_connection(void)
  */
 void
 mysql_rel_connection(MYSQL *conn)
+{
+	ConnCacheEntry *entry = mysql_find_connection(conn);
+
+	if (entry == NULL)
+		return;
+
+	/* A fetch in flight on the connection is abandoned */
+	if (entry->pending_scan != NULL)
+	{
+		entry->pending_scan->fetch_pending = false;
+		entry->pending_scan = NULL;
+	}
+	entry->streaming_scan = NULL;
+
+	elog(DEBUG3, "disconnecting mysql_fdw connection %p", entry->conn);
+	_mysql_close(entry->conn);
+	entry->conn = NULL;
+}
+
+/*
+ * mysql_get_pending_scan: Return the scan that has a fetch in flight on
+ * conn, or NULL if the connection is free.
+ */
+MySQLFdwExecState *
+mysql_get_pending_scan(MYSQL *conn)
+{
+	ConnCacheEntry *entry = mysql_find_connection(conn);
+
+	return entry ? entry->pending_scan : NULL;
+}
+
+/*
+ * mysql_set_pending_scan: Record that festate has a fetch in flight on
+ * conn, or, with NULL, that the connection is free again.  Each connection
+ * has at most one such fetch.
+ */
+void
+mysql_set_pending_scan(MYSQL *conn, MySQLFdwExecState *festate)
+{
+	ConnCacheEntry *entry = mysql_find_connection(conn);
+
+	if (entry != NULL)
+		entry->pending_scan = festate;
+}
+
+/*
+ * mysql_get_streaming_scan: Return the scan whose streaming result is still
+ * being read off conn, or NULL if there is none.
+ */
+MySQLFdwExecState *
+mysql_get_streaming_scan(MYSQL *conn)
+{
+	ConnCacheEntry *entry = mysql_find_connection(conn);
+
+	return entry ? entry->streaming_scan : NULL;
+}
+
+/*
+ * mysql_set_streaming_scan: Record that the result festate streams is
+ * still being read off conn, or, with NULL, that it is not any more.  No
+ * other statement can use the connection meanwhile.
+ */
+void
+mysql_set_streaming_scan(MYSQL *conn, MySQLFdwExecState *festate)
+{
+	ConnCacheEntry *entry = mysql_find_connection(conn);
+
+	if (entry != NULL)
+		entry->streaming_scan = festate;
+}
+
+/*
+ * mysql_find_connection: Find the cache entry of an open connection.
+ */
+static ConnCacheEntry *
+mysql_find_connection(MYSQL *conn)
 {
 	HASH_SEQ_STATUS	scan;
 	ConnCacheEntry *entry;
 
-	if (ConnectionHash == NULL)
-		return;
+	if (ConnectionHash == NULL || conn == NULL)
+		return NULL;
 
 	hash_seq_init(&scan, ConnectionHash);
 	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
 	{
-		if (entry->conn == NULL)
-			continue;
-
 		if (entry->conn == conn)
 		{
-			elog(DEBUG3, "disconnecting mysql_fdw connection %p", entry->conn);
-			_mysql_close(entry->conn);
-			entry->conn = NULL;
 			hash_seq_term(&scan);
-			break;
+			return entry;
 		}
 	}
+	return NULL;
 }
 
 
@@ -182,7 +279,9 @@ mysql_connect(
 	char *ssl_cert,
 	char *ssl_ca,
 	char *ssl_capath,
-	char *ssl_cipher)
+	char *ssl_cipher,
+	MySQLCompression compression,
+	int compression_level)
 {
 	MYSQL *conn = NULL;
 #if	MYSQL_VERSION_ID < 80000
@@ -209,6 +308,28 @@ mysql_connect(
         	_mysql_options(conn, MYSQL_INIT_COMMAND, svr_init_command);
 
 	_mysql_ssl_set(conn, ssl_key, ssl_cert, ssl_ca, ssl_capath, ssl_cipher);
+
+	/* The server falls back to no compression if it does not support it */
+	if (compression == MYSQL_COMPRESS_ZLIB)
+		_mysql_options(conn, MYSQL_OPT_COMPRESS, NULL);
+#ifdef MYSQL_FDW_ZSTD
+	else if (compression == MYSQL_COMPRESS_ZSTD)
+	{
+		_mysql_options(conn, MYSQL_OPT_COMPRESSION_ALGORITHMS, "zstd,zlib");
+		if (compression_level > 0)
+		{
+			unsigned int level = (unsigned int) compression_level;
+
+			_mysql_options(conn, MYSQL_OPT_ZSTD_COMPRESSION_LEVEL, &level);
+		}
+	}
+#endif
+
+#ifdef MYSQL_FDW_NONBLOCK
+	/* Let scans fetch without blocking when the library supports it */
+	if (_mysql_stmt_fetch_start != NULL)
+		_mysql_options(conn, MYSQL_OPT_NONBLOCK, 0);
+#endif
    
 	if (!_mysql_real_connect(conn, svr_address, svr_username, svr_password, svr_database, svr_port, NULL, 0))
 		ereport(ERROR,
@@ -21,8 +21,12 @@
 
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#if PG_VERSION_NUM >= 90600
+	#include "access/stratnum.h"
+#endif
 #include "access/sysattr.h"
 #include "access/transam.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_namespace.h"
 #include "catalog/pg_operator.h"
@@ -37,6 +41,7 @@
 #else
 	#include "optimizer/optimizer.h"
 #endif
+#include "optimizer/tlist.h"
 #include "parser/parsetree.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -53,6 +58,7 @@ typedef struct foreign_glob_cxt
 {
 	PlannerInfo *root;			/* global planner state */
 	RelOptInfo *foreignrel;		/* the foreign relation we are planning for */
+	Relids		relids;			/* relids of the tables it reads */
 } foreign_glob_cxt;
 
 /*
@@ -79,6 +85,7 @@ typedef struct deparse_expr_cxt
 {
 	PlannerInfo *root;			/* global planner state */
 	RelOptInfo *foreignrel;		/* the foreign relation we are planning for */
+	RelOptInfo *scanrel;		/* the relation its Vars come from */
 	StringInfo	buf;			/* output buffer to append to */
 	List	**params_list;	/* exprs that will become remote Params */
 } deparse_expr_cxt;
@@ -106,6 +113,10 @@ static void mysql_deparse_relabel_type(RelabelType *node, deparse_expr_cxt *cont
 static void mysql_deparse_bool_expr(BoolExpr *node, deparse_expr_cxt *context);
 static void mysql_deparse_null_test(NullTest *node, deparse_expr_cxt *context);
 static void mysql_deparse_array_expr(ArrayExpr *node, deparse_expr_cxt *context);
+#if PG_VERSION_NUM >= 90600
+static void mysql_deparse_aggref(Aggref *node, deparse_expr_cxt *context);
+static bool mysql_is_builtin_agg(Aggref *agg);
+#endif
 static void mysql_print_remote_param(int paramindex, Oid paramtype, int32 paramtypmod,
 				 deparse_expr_cxt *context);
 static void mysql_print_remote_placeholder(Oid paramtype, int32 paramtypmod,
@@ -113,7 +124,16 @@ static void mysql_print_remote_placeholder(Oid paramtype, int32 paramtypmod,
 static void mysql_deparse_relation(StringInfo buf, Relation rel);
 static void mysql_deparse_target_list(StringInfo buf, PlannerInfo *root, Index rtindex, Relation rel,
 					Bitmapset *attrs_used, List **retrieved_attrs, List *tlist, RelOptInfo *baserel);
-static void mysql_deparse_column_ref(StringInfo buf, int varno, int varattno, PlannerInfo *root);
+static void mysql_deparse_column_ref(StringInfo buf, int varno, int varattno, PlannerInfo *root,
+					bool qualify);
+static void mysql_deparse_from_expr(StringInfo buf, RelOptInfo *foreignrel,
+					deparse_expr_cxt *context);
+static void mysql_append_conditions(List *exprs, deparse_expr_cxt *context);
+#if PG_VERSION_NUM >= 120000
+static void mysql_append_limit_clause(deparse_expr_cxt *context);
+static void mysql_deparse_limit_value(Node *node, const char *none, deparse_expr_cxt *context);
+#endif
+static const char *mysql_join_type_sql(JoinType jointype);
 
 /*
  * Functions to construct string representation of a specific types.
@@ -251,7 +271,7 @@ mysql_deparse_insert(StringInfo buf, PlannerInfo *root,
 				appendStringInfoString(buf, ", ");
 			first = false;
 
-			mysql_deparse_column_ref(buf, rtindex, attnum, root);
+			mysql_deparse_column_ref(buf, rtindex, attnum, root, false);
 		}
 
 		appendStringInfoString(buf, ") VALUES (");
@@ -283,6 +303,72 @@ mysql_deparse_analyze(StringInfo sql, char *dbname, char *relname)
 	appendStringInfo(sql, " WHERE table_schema = '%s' AND table_name = '%s'", dbname, relname);
 }
 
+/*
+ * Deparse the query listing the primary key columns of a MySQL table
+ */
+void
+mysql_deparse_primary_key(StringInfo sql, char *dbname, char *relname)
+{
+	appendStringInfo(sql, "SELECT column_name, data_type, column_type");
+	appendStringInfo(sql, " FROM information_schema.COLUMNS");
+	appendStringInfo(sql, " WHERE table_schema = '%s' AND table_name = '%s'", dbname, relname);
+	appendStringInfo(sql, " AND column_key = 'PRI'");
+}
+
+/*
+ * Deparse the query listing the columns MySQL can read a table in the
+ * order of, those leading one of its indexes, with their distinct values
+ */
+void
+mysql_deparse_index_columns(StringInfo sql, char *dbname, char *relname)
+{
+	appendStringInfo(sql, "SELECT column_name, MAX(cardinality)");
+	appendStringInfo(sql, " FROM information_schema.STATISTICS");
+	appendStringInfo(sql, " WHERE table_schema = '%s' AND table_name = '%s'", dbname, relname);
+	appendStringInfo(sql, " AND seq_in_index = 1 GROUP BY column_name");
+}
+
+/*
+ * Deparse the query finding the smallest and largest value of key
+ */
+void
+mysql_deparse_key_bounds(StringInfo sql, char *dbname, char *relname, char *key)
+{
+	char *qkey = mysql_quote_identifier(key, '`');
+
+	appendStringInfo(sql, "SELECT MIN(%s), MAX(%s)", qkey, qkey);
+	appendStringInfo(sql, " FROM %s.%s", mysql_quote_identifier(dbname, '`'),
+					 mysql_quote_identifier(relname, '`'));
+}
+
+/*
+ * Append the condition limiting a parallel scan to a range of key values,
+ * whose bounds are given as the two last parameters of the query.
+ */
+void
+mysql_append_key_range(StringInfo buf, char *key, bool is_first)
+{
+	char *qkey = mysql_quote_identifier(key, '`');
+
+	appendStringInfo(buf, " %s (%s >= ? AND %s <= ?)", is_first ? "WHERE" : "AND", qkey, qkey);
+}
+
+/*
+ * Append the condition matching any of nkeys values of an integer key,
+ * given as parameters, to a query.
+ */
+void
+mysql_append_key_list(StringInfo buf, char *key, int nkeys, bool is_first)
+{
+	int i;
+
+	appendStringInfo(buf, " %s (%s IN (", is_first ? "WHERE" : "AND",
+					 mysql_quote_identifier(key, '`'));
+	for (i = 0; i < nkeys; i++)
+		appendStringInfoString(buf, i == 0 ? "?" : ", ?");
+	appendStringInfoString(buf, "))");
+}
+
 /*
  * Emit a target list that retrieves the columns specified in attrs_used.
  * This is used for both SELECT and RETURNING targetlists.
@@ -328,7 +414,7 @@ mysql_deparse_target_list(StringInfo buf,
 					appendStringInfoString(buf, ", ");
 				first = false;
 
-				mysql_deparse_column_ref(buf, rtindex, i, root);
+				mysql_deparse_column_ref(buf, rtindex, i, root, false);
 				*retrieved_attrs = lappend_int(*retrieved_attrs, i);
 			}
 		}
@@ -341,6 +427,7 @@ mysql_deparse_target_list(StringInfo buf,
 		deparse_expr_cxt context;
 		context.root = root;
 		context.foreignrel = baserel;
+		context.scanrel = baserel;
 		context.buf = buf;
 		context.params_list = NULL;
 		foreach (cell, tlist)
@@ -392,6 +479,7 @@ mysql_append_where_clause(StringInfo buf,
 	/* Set up context struct for recursion */
 	context.root = root;
 	context.foreignrel = baserel;
+	context.scanrel = baserel;
 	context.buf = buf;
 	context.params_list = params;
 
@@ -414,17 +502,416 @@ mysql_append_where_clause(StringInfo buf,
 }
 
 
+/*
+ * Deparse SELECT statement for a join or grouped relation.
+ *
+ * The target list is built from the expressions in tlist, with columns
+ * qualified by the alias of their table in a join, so the columns come back
+ * in tlist order and *retrieved_attrs is simply 1..n.  The remote conditions
+ * of the relation read become the WHERE clause; those of a grouped relation
+ * its HAVING clause.  Rows are sorted as pathkeys asks.
+ */
+void
+mysql_deparse_rel_select(StringInfo buf,
+						 PlannerInfo *root,
+						 RelOptInfo *foreignrel,
+						 List *tlist,
+						 List *pathkeys,
+						 List **retrieved_attrs,
+						 List **params)
+{
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) foreignrel->fdw_private;
+	MySQLFdwRelationInfo *scan_fpinfo;
+	RelOptInfo *scanrel;
+	deparse_expr_cxt context;
+	ListCell   *lc;
+	int			i = 0;
+
+#if PG_VERSION_NUM >= 120000
+	/* LIMIT and OFFSET apply to the rows of the relation below */
+	if (IS_UPPER_REL(foreignrel) && fpinfo->stage == UPPERREL_FINAL)
+	{
+		mysql_deparse_rel_select(buf, root, fpinfo->outerrel, tlist, pathkeys,
+								 retrieved_attrs, params);
+
+		context.root = root;
+		context.foreignrel = foreignrel;
+		context.scanrel = fpinfo->outerrel;
+		context.buf = buf;
+		context.params_list = params;
+		mysql_append_limit_clause(&context);
+		return;
+	}
+#endif
+
+	/* A grouped relation reads the relation below it */
+	scanrel = IS_UPPER_REL(foreignrel) ? fpinfo->outerrel : foreignrel;
+	scan_fpinfo = (MySQLFdwRelationInfo *) scanrel->fdw_private;
+
+	if (params)
+		*params = NIL;			/* initialize result list to empty */
+	*retrieved_attrs = NIL;
+
+	/* Set up context struct for recursion */
+	context.root = root;
+	context.foreignrel = foreignrel;
+	context.scanrel = scanrel;
+	context.buf = buf;
+	context.params_list = params;
+
+	appendStringInfoString(buf, "SELECT ");
+	foreach(lc, tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (i > 0)
+			appendStringInfoString(buf, ", ");
+		deparseExpr(tle->expr, &context);
+		*retrieved_attrs = lappend_int(*retrieved_attrs, ++i);
+	}
+
+	/* Don't generate bad syntax if no columns are needed */
+	if (i == 0)
+		appendStringInfoString(buf, "NULL");
+
+	appendStringInfoString(buf, " FROM ");
+	mysql_deparse_from_expr(buf, scanrel, &context);
+
+	if (scan_fpinfo->remote_conds != NIL)
+	{
+		appendStringInfoString(buf, " WHERE ");
+		mysql_append_conditions(scan_fpinfo->remote_conds, &context);
+	}
+
+	if (IS_UPPER_REL(foreignrel))
+	{
+		Query	   *query = root->parse;
+
+		if (query->groupClause != NIL)
+		{
+			bool		first = true;
+
+			appendStringInfoString(buf, " GROUP BY ");
+			foreach(lc, query->groupClause)
+			{
+				SortGroupClause *grp = (SortGroupClause *) lfirst(lc);
+				TargetEntry *tle = get_sortgroupref_tle(grp->tleSortGroupRef, tlist);
+
+				if (!first)
+					appendStringInfoString(buf, ", ");
+				deparseExpr(tle->expr, &context);
+				first = false;
+			}
+		}
+
+		if (fpinfo->remote_conds != NIL)
+		{
+			appendStringInfoString(buf, " HAVING ");
+			mysql_append_conditions(fpinfo->remote_conds, &context);
+		}
+	}
+
+#if PG_VERSION_NUM >= 90600
+	if (pathkeys != NIL)
+		mysql_append_order_by_clause(buf, root, foreignrel, pathkeys);
+#endif
+}
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * Find an expression of the equivalence class computed from the tables of
+ * rel alone, or NULL if there is none.
+ */
+Expr *
+mysql_find_em_expr(EquivalenceClass *ec, RelOptInfo *rel)
+{
+	ListCell   *lc;
+
+	foreach(lc, ec->ec_members)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+
+		if (!bms_is_empty(em->em_relids) &&
+			bms_is_subset(em->em_relids, rel->relids))
+			return em->em_expr;
+	}
+
+	return NULL;
+}
+
+/*
+ * Tell whether MySQL can sort the rows of rel as pathkey asks, giving the
+ * same order as here.
+ */
+bool
+mysql_is_foreign_pathkey(PlannerInfo *root, RelOptInfo *rel, PathKey *pathkey)
+{
+	EquivalenceClass *ec = pathkey->pk_eclass;
+	Expr	   *em_expr;
+
+	if (ec->ec_has_volatile)
+		return false;
+
+	/*
+	 * MySQL orders text by its own collations, and only knows the default
+	 * ordering of built-in types.
+	 */
+	if (OidIsValid(ec->ec_collation) || !is_builtin(pathkey->pk_opfamily))
+		return false;
+
+	em_expr = mysql_find_em_expr(ec, rel);
+	return em_expr != NULL && mysql_is_foreign_expr(root, rel, em_expr);
+}
+
+/*
+ * Tell whether the NULLs of pathkey go where MySQL would not put them.
+ * Columns of a table declared NOT NULL have none, unless they come from the
+ * nullable side of a join.
+ */
+bool
+mysql_pathkey_null_order_differs(PlannerInfo *root, RelOptInfo *rel, PathKey *pathkey)
+{
+	Expr	   *em_expr;
+	bool		ascending = (pathkey->pk_strategy == BTLessStrategyNumber);
+
+	if (pathkey->pk_nulls_first == ascending)
+		return false;
+
+	em_expr = mysql_find_em_expr(pathkey->pk_eclass, rel);
+	if (rel->reloptkind == RELOPT_BASEREL && em_expr != NULL &&
+		IsA(em_expr, Var) && ((Var *) em_expr)->varattno > 0)
+	{
+		Var		   *var = (Var *) em_expr;
+		RangeTblEntry *rte = planner_rt_fetch(var->varno, root);
+		HeapTuple	tuple;
+		bool		notnull = false;
+
+		tuple = SearchSysCache2(ATTNUM, ObjectIdGetDatum(rte->relid),
+								Int16GetDatum(var->varattno));
+		if (HeapTupleIsValid(tuple))
+		{
+			notnull = ((Form_pg_attribute) GETSTRUCT(tuple))->attnotnull;
+			ReleaseSysCache(tuple);
+		}
+		if (notnull)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Append an ORDER BY clause sorting the rows of rel as pathkeys asks.
+ *
+ * MySQL puts NULLs first when sorting up and last when sorting down, and
+ * has no NULLS FIRST/LAST; where those are wanted otherwise, the rows are
+ * first sorted on whether the value is NULL.
+ */
+void
+mysql_append_order_by_clause(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
+							 List *pathkeys)
+{
+	deparse_expr_cxt context;
+	ListCell   *lc;
+	bool		first = true;
+
+	context.root = root;
+	context.foreignrel = rel;
+	context.scanrel = rel;
+	context.buf = buf;
+	context.params_list = NULL;
+
+	appendStringInfoString(buf, " ORDER BY ");
+	foreach(lc, pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+		Expr	   *em_expr = mysql_find_em_expr(pathkey->pk_eclass, rel);
+		bool		ascending = (pathkey->pk_strategy == BTLessStrategyNumber);
+
+		Assert(em_expr != NULL);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		if (mysql_pathkey_null_order_differs(root, rel, pathkey))
+		{
+			deparseExpr(em_expr, &context);
+			appendStringInfoString(buf, pathkey->pk_nulls_first ? " IS NOT NULL, " : " IS NULL, ");
+		}
+
+		deparseExpr(em_expr, &context);
+		appendStringInfoString(buf, ascending ? " ASC" : " DESC");
+	}
+}
+#endif
+
+#if PG_VERSION_NUM >= 120000
+/*
+ * Tell whether a LIMIT or OFFSET expression can be sent to MySQL, which
+ * only takes a constant or a parameter there.  Negative constants are left
+ * to the Limit node to complain about.
+ */
+bool
+mysql_is_foreign_limit(Node *node)
+{
+	if (node == NULL)
+		return true;
+
+	if (IsA(node, Const))
+	{
+		Const	   *c = (Const *) node;
+
+		return c->consttype == INT8OID &&
+			(c->constisnull || DatumGetInt64(c->constvalue) >= 0);
+	}
+
+	return IsA(node, Param) && ((Param *) node)->paramtype == INT8OID;
+}
+
+/*
+ * Append the LIMIT and OFFSET clauses of the query.  MySQL has no OFFSET
+ * without LIMIT, so a missing LIMIT is given as the largest row count.
+ */
+static void
+mysql_append_limit_clause(deparse_expr_cxt *context)
+{
+	Query	   *query = context->root->parse;
+
+	appendStringInfoString(context->buf, " LIMIT ");
+	mysql_deparse_limit_value(query->limitCount, "18446744073709551615", context);
+
+	if (query->limitOffset != NULL &&
+		!(IsA(query->limitOffset, Const) && ((Const *) query->limitOffset)->constisnull))
+	{
+		appendStringInfoString(context->buf, " OFFSET ");
+		mysql_deparse_limit_value(query->limitOffset, "0", context);
+	}
+}
+
+/*
+ * Emit a LIMIT or OFFSET value.  A Param becomes a parameter of its own,
+ * even if it appears elsewhere in the query, since MySQL numbers them by
+ * position.  Without a value, or a parameter list to pass it in, the text
+ * none standing for no limit is emitted.
+ */
+static void
+mysql_deparse_limit_value(Node *node, const char *none, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+
+	if (node != NULL && IsA(node, Param) && context->params_list)
+	{
+		*context->params_list = lappend(*context->params_list, node);
+		appendStringInfoChar(buf, '?');
+	}
+	else if (node != NULL && IsA(node, Const) && !((Const *) node)->constisnull)
+		appendStringInfo(buf, INT64_FORMAT, DatumGetInt64(((Const *) node)->constvalue));
+	else
+		appendStringInfoString(buf, none);
+}
+#endif
+
+/*
+ * Emit the FROM clause for given relation: a base relation becomes its
+ * remote name followed by its alias, a join becomes a parenthesised
+ * "outer JOIN inner ON (...)" built recursively from both sides.
+ */
+static void
+mysql_deparse_from_expr(StringInfo buf, RelOptInfo *foreignrel,
+						deparse_expr_cxt *context)
+{
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) foreignrel->fdw_private;
+
+	if (IS_JOIN_REL(foreignrel))
+	{
+		appendStringInfoChar(buf, '(');
+		mysql_deparse_from_expr(buf, fpinfo->outerrel, context);
+		appendStringInfo(buf, " %s JOIN ", mysql_join_type_sql(fpinfo->jointype));
+		mysql_deparse_from_expr(buf, fpinfo->innerrel, context);
+
+		appendStringInfoString(buf, " ON ");
+		if (fpinfo->joinclauses != NIL)
+		{
+			appendStringInfoChar(buf, '(');
+			mysql_append_conditions(fpinfo->joinclauses, context);
+			appendStringInfoChar(buf, ')');
+		}
+		else
+			appendStringInfoString(buf, "(TRUE)");
+		appendStringInfoChar(buf, ')');
+	}
+	else
+	{
+		RangeTblEntry *rte = planner_rt_fetch(foreignrel->relid, context->root);
+		Relation	rel;
+
+		rel = heap_open(rte->relid, NoLock);
+		mysql_deparse_relation(buf, rel);
+		heap_close(rel, NoLock);
+
+		appendStringInfo(buf, " %s%d", MYSQL_REL_ALIAS_PREFIX, foreignrel->relid);
+	}
+}
+
+/*
+ * Emit a list of RestrictInfo conditions, ANDed together and each one
+ * parenthesised.
+ */
+static void
+mysql_append_conditions(List *exprs, deparse_expr_cxt *context)
+{
+	ListCell   *lc;
+	bool		is_first = true;
+
+	foreach(lc, exprs)
+	{
+		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+
+		if (!is_first)
+			appendStringInfoString(context->buf, " AND ");
+
+		appendStringInfoChar(context->buf, '(');
+		deparseExpr(ri->clause, context);
+		appendStringInfoChar(context->buf, ')');
+
+		is_first = false;
+	}
+}
+
+/*
+ * Return the MySQL keyword for the given join type.  MySQL has no FULL
+ * JOIN, so such joins never reach here.
+ */
+static const char *
+mysql_join_type_sql(JoinType jointype)
+{
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			return "INNER";
+		case JOIN_LEFT:
+			return "LEFT";
+		case JOIN_RIGHT:
+			return "RIGHT";
+		default:
+			elog(ERROR, "unsupported join type %d", jointype);
+	}
+
+	return NULL;				/* keep compiler quiet */
+}
+
 /*
  * Construct name to use for given column, and emit it into buf.
  * If it has a column_name FDW option, use that instead of attribute name.
+ * If qualify is true, prefix it with the alias of its relation.
  */
 static void
-mysql_deparse_column_ref(StringInfo buf, int varno, int varattno, PlannerInfo *root)
+mysql_deparse_column_ref(StringInfo buf, int varno, int varattno, PlannerInfo *root,
+						 bool qualify)
 {
 	RangeTblEntry *rte;
-	char          *colname = NULL;
-	List          *options;
-	ListCell      *lc;
+	char          *colname;
 
 	/* varno must not be any of OUTER_VAR, INNER_VAR and INDEX_VAR. */
 	Assert(!IS_SPECIAL_VARNO(varno));
@@ -432,34 +919,41 @@ mysql_deparse_column_ref(StringInfo buf, int varno, int varattno, PlannerInfo *r
 	/* Get RangeTblEntry from array in PlannerInfo. */
 	rte = planner_rt_fetch(varno, root);
 
-	/*
-	 * If it's a column of a foreign table, and it has the column_name FDW
-	 * option, use that value.
-	 */
-	options = GetForeignColumnOptions(rte->relid, varattno);
+	colname = mysql_get_column_name(rte->relid, varattno);
+
+	if (qualify)
+		appendStringInfo(buf, "%s%d.", MYSQL_REL_ALIAS_PREFIX, varno);
+	appendStringInfoString(buf, mysql_quote_identifier(colname, '`'));
+}
+
+/*
+ * Return the MySQL name of a column of a foreign table, which is the value
+ * of its column_name FDW option if it has one.
+ */
+char *
+mysql_get_column_name(Oid relid, int attnum)
+{
+	List          *options;
+	ListCell      *lc;
+
+	options = GetForeignColumnOptions(relid, attnum);
 	foreach(lc, options)
 	{
 		DefElem *def = (DefElem *) lfirst(lc);
 
 		if (strcmp(def->defname, "column_name") == 0)
-		{
-			colname = defGetString(def);
-			break;
-		}
+			return defGetString(def);
 	}
 
 	/*
 	 * If it's a column of a regular table or it doesn't have column_name FDW
 	 * option, use attribute name.
 	 */
-	if (colname == NULL)
 #if PG_VERSION_NUM >= 110000
-		colname = get_attname(rte->relid, varattno, false);
+	return get_attname(relid, attnum, false);
 #else
-		colname = get_relid_attribute_name(rte->relid, varattno);
+	return get_relid_attribute_name(relid, attnum);
 #endif
-
-	appendStringInfoString(buf, mysql_quote_identifier(colname, '`'));
 }
 
 
@@ -574,6 +1068,11 @@ deparseExpr(Expr *node, deparse_expr_cxt *context)
 		case T_ArrayExpr:
 			mysql_deparse_array_expr((ArrayExpr *) node, context);
 			break;
+#if PG_VERSION_NUM >= 90600
+		case T_Aggref:
+			mysql_deparse_aggref((Aggref *) node, context);
+			break;
+#endif
 		default:
 			elog(ERROR, "unsupported expression type for deparse: %d",
 				 (int) nodeTag(node));
@@ -668,7 +1167,7 @@ mysql_deparse_update(StringInfo buf, PlannerInfo *root,
 			appendStringInfoString(buf, ", ");
 		first = false;
 
-		mysql_deparse_column_ref(buf, rtindex, attnum, root);
+		mysql_deparse_column_ref(buf, rtindex, attnum, root, false);
 		appendStringInfo(buf, " = ?");
 		pindex++;
 	}
@@ -706,34 +1205,21 @@ mysql_deparse_var(Var *node, deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
 
-	if (node->varno == context->foreignrel->relid &&
+	if (bms_is_member(node->varno, context->scanrel->relids) &&
 		node->varlevelsup == 0)
 	{
-		/* Var belongs to foreign table */
-		mysql_deparse_column_ref(buf, node->varno, node->varattno, context->root);
+		/* Var belongs to foreign table, qualified if there are several */
+		mysql_deparse_column_ref(buf, node->varno, node->varattno, context->root,
+								 IS_JOIN_REL(context->scanrel));
 	}
 	else
 	{
 		/* Treat like a Param */
 		if (context->params_list)
 		{
-			int pindex = 0;
-			ListCell *lc;
-
-			/* find its index in params_list */
-			foreach(lc, *context->params_list)
-			{
-				pindex++;
-				if (equal(node, (Node *) lfirst(lc)))
-					break;
-			}
-			if (lc == NULL)
-			{
-				/* not in list, so add it */
-				pindex++;
-				*context->params_list = lappend(*context->params_list, node);
-			}
-			mysql_print_remote_param(pindex, node->vartype, node->vartypmod, context);
+			*context->params_list = lappend(*context->params_list, node);
+			mysql_print_remote_param(list_length(*context->params_list),
+									 node->vartype, node->vartypmod, context);
 		}
 		else
 		{
@@ -826,33 +1312,19 @@ mysql_deparse_const(Const *node, deparse_expr_cxt *context)
  * Deparse given Param node.
  *
  * If we're generating the query "for real", add the Param to
- * context->params_list if it's not already present, and then use its index
- * in that list as the remote parameter number.  During EXPLAIN, there's
- * no need to identify a parameter number.
+ * context->params_list, and use its index in that list as the remote
+ * parameter number.  MySQL numbers parameters by their position in the
+ * query, so one used twice is added twice.  During EXPLAIN, there's no
+ * need to identify a parameter number.
  */
 static void
 mysql_deparse_param(Param *node, deparse_expr_cxt *context)
 {
 	if (context->params_list)
 	{
-		int pindex = 0;
-		ListCell *lc;
-
-		/* find its index in params_list */
-		foreach(lc, *context->params_list)
-		{
-			pindex++;
-			if (equal(node, (Node *) lfirst(lc)))
-				break;
-		}
-		if (lc == NULL)
-		{
-			/* not in list, so add it */
-			pindex++;
-			*context->params_list = lappend(*context->params_list, node);
-		}
-
-		mysql_print_remote_param(pindex, node->paramtype, node->paramtypmod, context);
+		*context->params_list = lappend(*context->params_list, node);
+		mysql_print_remote_param(list_length(*context->params_list),
+								 node->paramtype, node->paramtypmod, context);
 	}
 	else
 	{
@@ -901,7 +1373,11 @@ mysql_deparse_array_ref(SubscriptingRef *node, deparse_expr_cxt *context)
 		{
 			deparseExpr(lfirst(lowlist_item), context);
 			appendStringInfoChar(buf, ':');
+#if PG_VERSION_NUM >= 130000
+			lowlist_item = lnext(node->reflowerindexpr, lowlist_item);
+#else
 			lowlist_item = lnext(lowlist_item);
+#endif
 		}
 		deparseExpr(lfirst(uplist_item), context);
 		appendStringInfoChar(buf, ']');
@@ -1315,6 +1791,86 @@ mysql_deparse_array_expr(ArrayExpr *node, deparse_expr_cxt *context)
 	appendStringInfoChar(buf, ']');
 }
 
+#if PG_VERSION_NUM >= 90600
+/*
+ * Deparse an Aggref node, as name([DISTINCT] args) or count(*).
+ */
+static void
+mysql_deparse_aggref(Aggref *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	bool		first = true;
+	ListCell   *lc;
+
+	appendStringInfo(buf, "%s(", get_func_name(node->aggfnoid));
+
+	if (node->aggstar)
+		appendStringInfoChar(buf, '*');
+	else
+	{
+		if (node->aggdistinct != NIL)
+			appendStringInfoString(buf, "DISTINCT ");
+
+		foreach(lc, node->args)
+		{
+			TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+			if (!first)
+				appendStringInfoString(buf, ", ");
+			deparseExpr(tle->expr, context);
+			first = false;
+		}
+	}
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * Tell whether the aggregate is a built-in one MySQL has under the same
+ * name, giving the same result.  MySQL sums in DECIMAL or DOUBLE, which is
+ * what PostgreSQL does for integers and float8, but it rounds averages of
+ * exact numbers to div_precision_increment digits and sums float4 in
+ * double precision; those are left to be computed here.
+ */
+static bool
+mysql_is_builtin_agg(Aggref *agg)
+{
+	char	   *aggname;
+	Oid			argtype;
+
+	if (!is_builtin(agg->aggfnoid))
+		return false;
+
+	aggname = get_func_name(agg->aggfnoid);
+	if (strcmp(aggname, "count") == 0 ||
+		strcmp(aggname, "min") == 0 ||
+		strcmp(aggname, "max") == 0)
+		return true;
+
+	if (list_length(agg->args) != 1)
+		return false;
+	argtype = exprType((Node *) ((TargetEntry *) linitial(agg->args))->expr);
+
+	if (strcmp(aggname, "sum") == 0)
+	{
+		switch (argtype)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT8OID:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	if (strcmp(aggname, "avg") == 0)
+		return argtype == FLOAT8OID;
+
+	return false;
+}
+#endif
+
 /*
  * Print the representation of a parameter to be sent to the remote side.
  *
@@ -1409,7 +1965,7 @@ foreign_expr_walker(Node *node,
 				 * Param's collation, ie it's not safe for it to have a
 				 * non-default collation.
 				 */
-				if (var->varno == glob_cxt->foreignrel->relid &&
+				if (bms_is_member(var->varno, glob_cxt->relids) &&
 					var->varlevelsup == 0)
 				{
 					/* Var belongs to foreign table */
@@ -1715,6 +2271,59 @@ foreign_expr_walker(Node *node,
 					state = FDW_COLLATE_UNSAFE;
 			}
 			break;
+#if PG_VERSION_NUM >= 90600
+		case T_Aggref:
+			{
+				Aggref	   *agg = (Aggref *) node;
+				ListCell   *lc;
+
+				/* Aggregates are only computed by a grouped relation */
+				if (!IS_UPPER_REL(glob_cxt->foreignrel))
+					return false;
+
+				/*
+				 * Only whole, plain aggregates MySQL has too, without ORDER
+				 * BY or FILTER.
+				 */
+				if (agg->aggsplit != AGGSPLIT_SIMPLE ||
+					agg->aggkind != AGGKIND_NORMAL ||
+					agg->aggorder != NIL || agg->aggfilter != NULL ||
+					agg->aggvariadic ||
+					!mysql_is_builtin_agg(agg))
+					return false;
+
+				/*
+				 * MySQL compares text by its own collations, which would
+				 * change the values that count as the smallest, largest or
+				 * distinct ones.
+				 */
+				if (OidIsValid(agg->inputcollid) &&
+					(agg->aggdistinct != NIL ||
+					 strcmp(get_func_name(agg->aggfnoid), "count") != 0))
+					return false;
+
+				/* Recurse to the arguments, which are TargetEntries */
+				foreach(lc, agg->args)
+				{
+					TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+					if (!foreign_expr_walker((Node *) tle->expr,
+											 glob_cxt, &inner_cxt))
+						return false;
+				}
+
+				/* Result-collation handling is same as for functions */
+				collation = agg->aggcollid;
+				if (collation == InvalidOid)
+					state = FDW_COLLATE_NONE;
+				else if (inner_cxt.state == FDW_COLLATE_SAFE &&
+						 collation == inner_cxt.collation)
+					state = FDW_COLLATE_SAFE;
+				else
+					state = FDW_COLLATE_UNSAFE;
+			}
+			break;
+#endif
 		case T_List:
 			{
 				List	   *l = (List *) node;
@@ -1823,14 +2432,24 @@ mysql_is_foreign_expr(PlannerInfo *root,
          */
         glob_cxt.root = root;
         glob_cxt.foreignrel = baserel;
+
+        /* The Vars of a grouped relation come from the relation below it */
+        if (IS_UPPER_REL(baserel))
+                glob_cxt.relids = ((MySQLFdwRelationInfo *) baserel->fdw_private)->outerrel->relids;
+        else
+                glob_cxt.relids = baserel->relids;
+
         loc_cxt.collation = InvalidOid;
         loc_cxt.state = FDW_COLLATE_NONE;
         if (!foreign_expr_walker((Node *) expr, &glob_cxt, &loc_cxt))
                 return false;
 
-        /* Expressions examined here should be boolean, ie noncollatable */
-        Assert(loc_cxt.collation == InvalidOid);
-        Assert(loc_cxt.state == FDW_COLLATE_NONE);
+        /*
+         * Conditions are boolean, but target expressions of a grouped
+         * relation may have a collation, which must come from a foreign Var.
+         */
+        if (loc_cxt.state == FDW_COLLATE_UNSAFE)
+                return false;
 
         /* OK to evaluate on the remote server */
         return true;
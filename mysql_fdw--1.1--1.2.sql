@@ -0,0 +1,13 @@
+/* mysql_fdw/mysql_fdw--1.1--1.2.sql */
+
+CREATE FUNCTION mysql_fdw_calibrate(server text,
+  OUT rtt_ms pg_catalog.float8, OUT fdw_byte_cost pg_catalog.float8)
+  RETURNS record STRICT
+  AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION mysql_fdw_invalidate_estimates(server text DEFAULT NULL)
+  RETURNS pg_catalog.int8
+  AS 'MODULE_PATHNAME' LANGUAGE C;
+
+-- The estimates are shared by all sessions, don't let anyone empty them
+REVOKE ALL ON FUNCTION mysql_fdw_invalidate_estimates(text) FROM PUBLIC;
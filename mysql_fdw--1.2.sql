@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------------
+ *
+ * mysql_fdw--1.2.sql
+ * 			Foreign-data wrapper for remote MySQL servers
+ *
+ * Portions Copyright (c) 2012-2014, PostgreSQL Global Development Group
+ *
+ * Portions Copyright (c) 2004-2014, EnterpriseDB Corporation.
+ *
+ * IDENTIFICATION
+ * 			mysql_fdw--1.2.sql
+ *
+ *-------------------------------------------------------------------------
+ */
+
+
+CREATE FUNCTION mysql_fdw_handler()
+RETURNS fdw_handler
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION mysql_fdw_validator(text[], oid)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FOREIGN DATA WRAPPER mysql_fdw
+  HANDLER mysql_fdw_handler
+  VALIDATOR mysql_fdw_validator;
+
+CREATE FUNCTION MATCH_AGAINST(varidiadic text[]) RETURNS INT AS $$
+BEGIN
+  RETURN 1;
+END
+$$ LANGUAGE plpgsql IMMUTABLE;
+
+CREATE OR REPLACE FUNCTION mysql_fdw_version()
+  RETURNS pg_catalog.int4 STRICT
+  AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION mysql_fdw_calibrate(server text,
+  OUT rtt_ms pg_catalog.float8, OUT fdw_byte_cost pg_catalog.float8)
+  RETURNS record STRICT
+  AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION mysql_fdw_invalidate_estimates(server text DEFAULT NULL)
+  RETURNS pg_catalog.int8
+  AS 'MODULE_PATHNAME' LANGUAGE C;
+
+-- The estimates are shared by all sessions, don't let anyone empty them
+REVOKE ALL ON FUNCTION mysql_fdw_invalidate_estimates(text) FROM PUBLIC;
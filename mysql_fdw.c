@@ -17,6 +17,8 @@
 #include "mysql_fdw.h"
 
 #include <stdio.h>
+#include <ctype.h>
+#include <math.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <dlfcn.h>
@@ -25,10 +27,24 @@
 #include <errmsg.h>
 
 #include "access/reloptions.h"
+#if PG_VERSION_NUM >= 130000
+	#include "common/hashfn.h"
+	#include "common/jsonapi.h"
+#else
+	#include "access/hash.h"
+	#include "utils/jsonapi.h"
+#endif
+#if PG_VERSION_NUM >= 90600
+	#include "access/parallel.h"
+	#include "access/stratnum.h"
+#endif
 #if PG_VERSION_NUM >= 120000
 	#include "access/table.h"
 #endif
 #include "catalog/pg_foreign_server.h"
+#if PG_VERSION_NUM >= 140000
+	#include "executor/execAsync.h"
+#endif
 #include "catalog/pg_foreign_table.h"
 #include "catalog/pg_user_mapping.h"
 #include "catalog/pg_type.h"
@@ -44,12 +60,21 @@
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
 #include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/shmem.h"
+#if PG_VERSION_NUM >= 100000
+	#include "pgstat.h"
+#endif
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/date.h"
+#include "utils/datum.h"
 #include "utils/hsearch.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/selfuncs.h"
+#include "utils/syscache.h"
 #include "utils/timestamp.h"
 #include "utils/formatting.h"
 #include "utils/memutils.h"
@@ -60,6 +85,7 @@
 #include "commands/vacuum.h"
 #include "foreign/fdwapi.h"
 #include "funcapi.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -69,12 +95,16 @@
 #include "optimizer/planmain.h"
 #include "optimizer/prep.h"
 #include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
 #if PG_VERSION_NUM < 120000
+	#include "optimizer/clauses.h"
 	#include "optimizer/var.h"
 #else
 	#include "optimizer/optimizer.h"
 #endif
 #include "parser/parsetree.h"
+#include "executor/spi.h"
+#include "portability/instr_time.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/lsyscache.h"
@@ -87,6 +117,19 @@
 
 #define DEFAULTE_NUM_ROWS    1000
 
+#ifndef RINFO_IS_PUSHED_DOWN
+#define RINFO_IS_PUSHED_DOWN(rinfo, joinrelids) ((rinfo)->is_pushed_down)
+#endif
+
+/* Callbacks of the JSON parser return an error code from PG version 16 */
+#if PG_VERSION_NUM >= 160000
+#define MYSQL_JSON_ACTION	JsonParseErrorType
+#define MYSQL_JSON_DONE		return JSON_SUCCESS
+#else
+#define MYSQL_JSON_ACTION	void
+#define MYSQL_JSON_DONE		return
+#endif
+
 /*
  * In PG 9.5.1 the number will be 90501,
  * our version is 2.5.3 so number will be 20503
@@ -96,19 +139,33 @@
 PG_MODULE_MAGIC;
 
 
-typedef struct MySQLFdwRelationInfo
+/*
+ * Indexes of FDW-private information stored in fdw_private lists.
+ */
+enum FdwScanPrivateIndex
 {
-	/* baserestrictinfo clauses, broken down into safe and unsafe subsets. */
-	List	   *remote_conds;
-	List	   *local_conds;
-
-	/* Bitmap of attr numbers we need to fetch from the remote server. */
-	Bitmapset  *attrs_used;
-
-} MySQLFdwRelationInfo;
+	/* SQL statement to execute remotely (as a String node) */
+	FdwScanPrivateSelectSql,
+	/* Integer list of attribute numbers retrieved by the SELECT */
+	FdwScanPrivateRetrievedAttrs,
+	/* Whether the target list is pushed down (as an Integer node) */
+	FdwScanPrivateTlistPushdown,
+	/* MySQLFetchMode chosen at plan time (as an Integer node) */
+	FdwScanPrivateFetchMode,
+	/* Query finding the key range of a parallel scan, or "" (as a String node) */
+	FdwScanPrivateBoundsSql,
+	/* Integer list of the indexes of the LIMIT and OFFSET parameters, or -1 */
+	FdwScanPrivateLimitParams,
+	/* Integer list of the lookup key column and keys per lookup, or zeros */
+	FdwScanPrivateLookupKey,
+	/* How MySQL said it reads the tables, or "" (as a String node) */
+	FdwScanPrivateRemoteAccess
+};
 
 
 extern Datum mysql_fdw_handler(PG_FUNCTION_ARGS);
+extern Datum mysql_fdw_calibrate(PG_FUNCTION_ARGS);
+extern Datum mysql_fdw_invalidate_estimates(PG_FUNCTION_ARGS);
 extern PGDLLEXPORT void _PG_init(void);
 
 bool mysql_load_library(void);
@@ -116,6 +173,8 @@ static void mysql_fdw_exit(int code, Datum arg);
 
 PG_FUNCTION_INFO_V1(mysql_fdw_handler);
 PG_FUNCTION_INFO_V1(mysql_fdw_version);
+PG_FUNCTION_INFO_V1(mysql_fdw_calibrate);
+PG_FUNCTION_INFO_V1(mysql_fdw_invalidate_estimates);
 
 /*
  * FDW callback routines
@@ -142,6 +201,40 @@ static void mysqlEndForeignModify(EState *estate, ResultRelInfo *resultRelInfo);
 
 static void mysqlGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid);
 static void mysqlGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid);
+#if PG_VERSION_NUM >= 90600
+static void mysqlGetForeignJoinPaths(PlannerInfo *root, RelOptInfo *joinrel, RelOptInfo *outerrel,
+									 RelOptInfo *innerrel, JoinType jointype, JoinPathExtraData *extra);
+static bool mysql_same_scan_options(mysql_opt *a, mysql_opt *b);
+static bool mysql_foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel, JoinType jointype,
+								  RelOptInfo *outerrel, RelOptInfo *innerrel, JoinPathExtraData *extra);
+static void mysqlGetForeignUpperPaths(PlannerInfo *root, UpperRelationKind stage,
+									  RelOptInfo *input_rel, RelOptInfo *output_rel
+#if PG_VERSION_NUM >= 110000
+									  , void *extra
+#endif
+									  );
+static bool mysql_foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel,
+									  List *having_quals, List **group_exprs);
+#if PG_VERSION_NUM >= 120000
+static void mysql_add_ordered_rel(PlannerInfo *root, RelOptInfo *input_rel,
+								  RelOptInfo *ordered_rel);
+static void mysql_add_final_path(PlannerInfo *root, RelOptInfo *input_rel,
+								 RelOptInfo *final_rel, FinalPathExtraData *extra);
+static double mysql_fetched_rows(RelOptInfo *rel, mysql_opt *options, double rows,
+								 double needed);
+#endif
+static List *mysql_build_tlist(RelOptInfo *foreignrel);
+static List *mysql_get_useful_pathkeys(PlannerInfo *root, RelOptInfo *rel);
+static Cost mysql_sort_cost(PlannerInfo *root, RelOptInfo *rel, List *pathkeys);
+static MySQLIndexColumn *mysql_find_index_column(PlannerInfo *root, RelOptInfo *rel, Expr *expr);
+static List *mysql_get_param_infos(PlannerInfo *root, RelOptInfo *baserel);
+static bool mysql_ec_member_matches(PlannerInfo *root, RelOptInfo *rel, EquivalenceClass *ec,
+									EquivalenceMember *em, void *arg);
+static void mysql_param_path_estimate(PlannerInfo *root, RelOptInfo *baserel, ParamPathInfo *ppi,
+									  double *rows, Cost *startup_cost, Cost *run_cost);
+static ForeignScan *mysql_get_rel_plan(PlannerInfo *root, RelOptInfo *foreignrel,
+									   ForeignPath *best_path, List *tlist, Plan *outer_plan);
+#endif
 static bool mysqlAnalyzeForeignTable(Relation relation, AcquireSampleRowsFunc *func, BlockNumber *totalpages);
 static ForeignScan *mysqlGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid,
 										ForeignPath *best_path, List * tlist, List *scan_clauses
@@ -149,35 +242,154 @@ static ForeignScan *mysqlGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel,
 		                                ,Plan * outer_plan
 #endif
 );
-static void mysqlEstimateCosts(PlannerInfo *root, RelOptInfo *baserel, Cost *startup_cost, Cost *total_cost,
-							   Oid foreigntableid);
+static void mysqlEstimateCosts(RelOptInfo *rel, mysql_opt *options, double rows,
+							   Cost *startup_cost, Cost *run_cost);
 
 #if PG_VERSION_NUM >= 90500
 static List *mysqlImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid);
 #endif
 
+#if PG_VERSION_NUM >= 90600
+static bool mysqlIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte);
+static Size mysqlEstimateDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt);
+static void mysqlInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+										  void *coordinate);
+#if PG_VERSION_NUM >= 100000
+static void mysqlReInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+											void *coordinate);
+#endif
+static void mysqlInitializeWorkerForeignScan(ForeignScanState *node, shm_toc *toc,
+											 void *coordinate);
+static void mysql_parallel_bounds(MySQLFdwExecState *festate, MySQLParallelScan *pscan);
+static bool mysql_next_range(MySQLFdwExecState *festate);
+#endif
+static char *mysql_find_parallel_key(MYSQL *conn, mysql_opt *options);
+static MySQLTableMeta *mysql_table_meta(Oid relid);
+static void mysql_table_meta_invalidate(Datum arg, int cacheid, uint32 hashvalue);
+static void mysql_table_meta_reset(MySQLTableMeta *meta);
+static List *mysql_find_index_columns(MYSQL *conn, mysql_opt *options);
+static List *mysql_copy_index_columns(List *columns);
+static MYSQL *mysql_plan_connection(MySQLFdwRelationInfo *fpinfo);
+static MYSQL_RES *mysql_run_query(MYSQL *conn, const char *query);
+static void mysql_explain_query(MYSQL *conn, const char *query, MySQLRemoteEstimate *estimate);
+static bool mysql_explain_json(MYSQL *conn, const char *query, MySQLRemoteEstimate *estimate);
+static void mysql_explain_table(MYSQL *conn, const char *query, MySQLRemoteEstimate *estimate);
+static void mysql_append_access(MySQLRemoteEstimate *estimate, const char *type,
+								const char *key, const char *parts);
+static double mysql_json_number(const char *token, JsonTokenType tokentype);
+static MYSQL_JSON_ACTION mysql_json_object_start(void *arg);
+static MYSQL_JSON_ACTION mysql_json_object_end(void *arg);
+static MYSQL_JSON_ACTION mysql_json_array_start(void *arg);
+static MYSQL_JSON_ACTION mysql_json_array_end(void *arg);
+static MYSQL_JSON_ACTION mysql_json_field_start(void *arg, char *fname, bool isnull);
+static MYSQL_JSON_ACTION mysql_json_scalar(void *arg, char *token, JsonTokenType tokentype);
+static void mysql_remote_cost(mysql_opt *options, MySQLRemoteEstimate *estimate, double share,
+							  Cost *startup_cost, Cost *run_cost);
+static double mysql_time_query(MYSQL *conn, const char *query);
+static void mysql_normalize_query(const char *query, StringInfo buf);
+static HTAB *mysql_estimate_cache(void);
+static void mysql_estimate_key(Oid serverid, const char *query, MySQLEstimateKey *key, StringInfo buf);
+static bool mysql_estimate_lookup(Oid serverid, const char *query, MySQLRemoteEstimate *estimate);
+static void mysql_estimate_store(Oid serverid, const char *query, MySQLRemoteEstimate *estimate);
+#if PG_VERSION_NUM >= 90600
+static Size mysql_estimate_shmem_size(void);
+static void mysql_estimate_shmem_request(void);
+static void mysql_estimate_shmem_startup(void);
+#endif
+static void mysql_set_server_option(ForeignServer *server, const char *name, double value);
+
+#if PG_VERSION_NUM >= 140000
+static bool mysqlIsForeignPathAsyncCapable(ForeignPath *path);
+static void mysqlForeignAsyncRequest(AsyncRequest *areq);
+static void mysqlForeignAsyncConfigureWait(AsyncRequest *areq);
+static void mysqlForeignAsyncNotify(AsyncRequest *areq);
+static void mysql_produce_tuple_async(AsyncRequest *areq);
+#endif
+
 static bool mysql_is_column_unique(Oid foreigntableid);
 
 static void prepare_query_params(PlanState *node,
-					 List *fdw_exprs,
-					 int numParams,
-					 FmgrInfo **param_flinfo,
-					 List **param_exprs,
-					 const char ***param_values,
-					 Oid **param_types);
-
-static void process_query_params(ExprContext *econtext,
-					 FmgrInfo *param_flinfo,
-					 List *param_exprs,
-					 const char **param_values,
-					 MYSQL_BIND **mysql_bind_buf,
-					 Oid *param_types);
-
-static void create_cursor(ForeignScanState *node);
+					 MySQLFdwExecState *festate,
+					 List *fdw_exprs);
+
+static bool process_query_params(ExprContext *econtext,
+					 MySQLFdwExecState *festate);
+
+static bool bind_query_params(ForeignScanState *node);
+static void mysql_reset_scan(MySQLFdwExecState *festate);
+static void mysql_start_scan(MySQLFdwExecState *festate);
+static void mysql_bind_scan(ForeignScanState *node);
+static void mysql_end_streaming(MySQLFdwExecState *festate);
+static bool mysql_next_tuple(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot);
+static void mysql_fetch_batch(MySQLFdwExecState *festate);
+static void mysql_fill_tuplestore(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot);
+static void mysql_buffer_streaming(MySQLFdwExecState *festate);
+static void mysql_fetch_overflow(MySQLFdwExecState *festate);
+static MySQLFetchMode mysql_choose_fetch_mode(RelOptInfo *baserel, double rows);
+#if PG_VERSION_NUM >= 90600
+static RestrictInfo *mysql_find_lookup_key(RelOptInfo *baserel, List *remote_conds, Expr *param,
+										   AttrNumber *attnum);
+#endif
+static bool mysql_is_lookup_type(Oid type);
+static const char *mysql_fetch_mode_name(MySQLFetchMode fetch_mode);
+static int mysql_execute_scan(MySQLFdwExecState *festate);
+static int mysql_fetch_row(MySQLFdwExecState *festate);
+#ifdef MYSQL_FDW_NONBLOCK
+static int mysql_async_finish(MySQLFdwExecState *festate, int status, int *ret,
+							  int (*cont) (int *ret, MYSQL_STMT *stmt, int status));
+static int mysql_async_wait(MYSQL *conn, int status);
+static bool mysql_fetch_ready(MySQLFdwExecState *festate);
+static void mysql_scan_reset_callback(void *arg);
+#endif
+static void mysql_stmt_error_report(MySQLFdwExecState *festate, const char *msg);
+static void mysql_explain_property_int(const char *qlabel, const char *unit, int64 value,
+									   ExplainState *es);
+static void mysql_explain_property_float(const char *qlabel, const char *unit, double value,
+										 int ndigits, ExplainState *es);
+static void mysql_track_memory(MySQLFdwExecState *festate);
+static bool mysql_charset_matches(MYSQL *conn);
+static bool mysql_row_qualifies(MySQLFdwExecState *festate, int row);
+static void mysql_setup_late_qual(ForeignScanState *node, MySQLFdwExecState *festate);
+#if PG_VERSION_NUM >= 130000
+static Size mysql_scan_memory(MySQLFdwExecState *festate);
+#endif
+static bool mysql_contain_param_walker(Node *node, void *context);
+static uint32 mysql_cache_hash(const void *key, Size keysize);
+static int mysql_cache_match(const void *key1, const void *key2, Size keysize);
+static bool mysql_cache_lookup(ForeignScanState *node);
+static MySQLCacheEntry *mysql_cache_search(ForeignScanState *node, Datum *values, bool *nulls,
+										   HASHACTION action, bool *found);
+static void mysql_cache_collect(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot, bool done);
+static bool mysql_cache_add(MySQLFdwExecState *festate, MySQLCacheEntry *entry,
+							TupleTableSlot *tupleSlot);
+static bool mysql_lookup_batch(ForeignScanState *node);
+static void mysql_lookup_one(MySQLFdwExecState *festate);
+static MySQLCacheEntry *mysql_lookup_entry(ForeignScanState *node, int64 key, HASHACTION action,
+										   bool *found);
+static int64 mysql_lookup_value(Oid type, Datum value);
+static void mysql_cache_next(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot);
+static void mysql_cache_remove(MySQLFdwExecState *festate, MySQLCacheEntry *entry);
 
 void* mysql_dll_handle = NULL;
 static int wait_timeout = WAIT_TIMEOUT;
+static int fetch_size_override = 0;
+static bool rescan_cache = true;
 static int interactive_timeout = INTERACTIVE_TIMEOUT;
+static int estimate_cache_size = 1024;
+static int estimate_cache_ttl = 60;
+
+/* Cache of remote row estimates, in shared memory or local */
+static MySQLEstimateShared *estimate_shared = NULL;
+static HTAB *estimate_htab = NULL;
+
+/* Cache of per-table metadata, local */
+static HTAB *table_meta_htab = NULL;
+#if PG_VERSION_NUM >= 90600
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+#endif
 
 /*
  * mysql_load_library function dynamically load the mysql's library
@@ -225,6 +437,7 @@ mysql_load_library(void)
 	_mysql_stmt_prepare = dlsym(mysql_dll_handle, "mysql_stmt_prepare");
 	_mysql_stmt_execute = dlsym(mysql_dll_handle, "mysql_stmt_execute");
 	_mysql_stmt_fetch = dlsym(mysql_dll_handle, "mysql_stmt_fetch");
+	_mysql_stmt_fetch_column = dlsym(mysql_dll_handle, "mysql_stmt_fetch_column");
 	_mysql_query = dlsym(mysql_dll_handle, "mysql_query");
 	_mysql_stmt_result_metadata = dlsym(mysql_dll_handle, "mysql_stmt_result_metadata");
 	_mysql_stmt_store_result = dlsym(mysql_dll_handle, "mysql_stmt_store_result");
@@ -243,12 +456,37 @@ mysql_load_library(void)
 	_mysql_stmt_attr_set = dlsym(mysql_dll_handle, "mysql_stmt_attr_set");
 	_mysql_store_result = dlsym(mysql_dll_handle, "mysql_store_result");
 	_mysql_stmt_errno = dlsym(mysql_dll_handle, "mysql_stmt_errno");
+	_mysql_stmt_error = dlsym(mysql_dll_handle, "mysql_stmt_error");
 	_mysql_errno = dlsym(mysql_dll_handle, "mysql_errno");
 	_mysql_num_fields = dlsym(mysql_dll_handle, "mysql_num_fields");
 	_mysql_num_rows = dlsym(mysql_dll_handle, "mysql_num_rows");
+	_mysql_character_set_name = dlsym(mysql_dll_handle, "mysql_character_set_name");
 	_mysql_get_host_info = dlsym(mysql_dll_handle, "mysql_get_host_info");
 	_mysql_get_server_info = dlsym(mysql_dll_handle, "mysql_get_server_info");
 	_mysql_get_proto_info = dlsym(mysql_dll_handle, "mysql_get_proto_info");
+
+#ifdef MYSQL_FDW_NONBLOCK
+	/* Optional, scans block when the library lacks any of these */
+	_mysql_stmt_execute_start = dlsym(mysql_dll_handle, "mysql_stmt_execute_start");
+	_mysql_stmt_execute_cont = dlsym(mysql_dll_handle, "mysql_stmt_execute_cont");
+	_mysql_stmt_fetch_start = dlsym(mysql_dll_handle, "mysql_stmt_fetch_start");
+	_mysql_stmt_fetch_cont = dlsym(mysql_dll_handle, "mysql_stmt_fetch_cont");
+	_mysql_get_socket = dlsym(mysql_dll_handle, "mysql_get_socket");
+	_mysql_get_timeout_value = dlsym(mysql_dll_handle, "mysql_get_timeout_value");
+
+	if (_mysql_stmt_execute_start == NULL ||
+		_mysql_stmt_execute_cont == NULL ||
+		_mysql_stmt_fetch_start == NULL ||
+		_mysql_stmt_fetch_cont == NULL ||
+		_mysql_get_socket == NULL ||
+		_mysql_get_timeout_value == NULL)
+	{
+		_mysql_stmt_execute_start = NULL;
+		_mysql_stmt_execute_cont = NULL;
+		_mysql_stmt_fetch_start = NULL;
+		_mysql_stmt_fetch_cont = NULL;
+	}
+#endif
 	
 	if (_mysql_stmt_bind_param == NULL ||
 		_mysql_stmt_bind_result == NULL ||
@@ -256,6 +494,7 @@ mysql_load_library(void)
 		_mysql_stmt_prepare == NULL ||
 		_mysql_stmt_execute == NULL ||
 		_mysql_stmt_fetch == NULL ||
+		_mysql_stmt_fetch_column == NULL ||
 		_mysql_query == NULL ||
 		_mysql_stmt_result_metadata == NULL ||
 		_mysql_stmt_store_result == NULL ||
@@ -274,9 +513,11 @@ mysql_load_library(void)
 		_mysql_stmt_attr_set == NULL ||
 		_mysql_store_result == NULL ||
 		_mysql_stmt_errno == NULL ||
+		_mysql_stmt_error == NULL ||
 		_mysql_errno == NULL ||
 		_mysql_num_fields == NULL ||
 		_mysql_num_rows == NULL ||
+		_mysql_character_set_name == NULL ||
 		_mysql_get_host_info == NULL ||
 		_mysql_get_server_info == NULL ||
 		_mysql_get_proto_info == NULL)
@@ -324,6 +565,73 @@ _PG_init(void)
 							NULL,
 							NULL,
 							NULL);
+	DefineCustomIntVariable("mysql_fdw.fetch_size",
+							"Rows fetched from MySQL per round trip",
+							"Overrides the fetch_size option of all foreign "
+							"servers and tables, unless set to 0.",
+							&fetch_size_override,
+							0,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("mysql_fdw.rescan_cache",
+							 "Keeps the rows of rescans for later rescans with the same parameters",
+							 "The rows kept by one scan are limited to work_mem.",
+							 &rescan_cache,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("mysql_fdw.estimate_cache_size",
+							"Remote row estimates kept for later planning",
+							"Shared by all sessions when mysql_fdw is in "
+							"shared_preload_libraries.  0 disables the cache.",
+							&estimate_cache_size,
+							1024,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("mysql_fdw.estimate_cache_ttl",
+							"Time a remote row estimate is used for",
+							"0 asks MySQL every time.",
+							&estimate_cache_ttl,
+							60,
+							0,
+							INT_MAX / 1000,
+							PGC_USERSET,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+#if PG_VERSION_NUM >= 90600
+	/* The estimates are shared when the library is preloaded */
+	if (process_shared_preload_libraries_in_progress && estimate_cache_size > 0)
+	{
+#if PG_VERSION_NUM >= 150000
+		prev_shmem_request_hook = shmem_request_hook;
+		shmem_request_hook = mysql_estimate_shmem_request;
+#else
+		mysql_estimate_shmem_request();
+#endif
+		prev_shmem_startup_hook = shmem_startup_hook;
+		shmem_startup_hook = mysql_estimate_shmem_startup;
+	}
+#endif
+
 	on_proc_exit(&mysql_fdw_exit, PointerGetDatum(NULL));
 }
 
@@ -348,6 +656,10 @@ mysql_fdw_handler(PG_FUNCTION_ARGS)
 	/* Callback functions for readable FDW */
 	fdwroutine->GetForeignRelSize = mysqlGetForeignRelSize;
 	fdwroutine->GetForeignPaths = mysqlGetForeignPaths;
+#if PG_VERSION_NUM >= 90600
+	fdwroutine->GetForeignJoinPaths = mysqlGetForeignJoinPaths;
+	fdwroutine->GetForeignUpperPaths = mysqlGetForeignUpperPaths;
+#endif
 	fdwroutine->AnalyzeForeignTable = mysqlAnalyzeForeignTable;
 	fdwroutine->GetForeignPlan = mysqlGetForeignPlan;
 	fdwroutine->ExplainForeignScan = mysqlExplainForeignScan;
@@ -360,6 +672,25 @@ mysql_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->ImportForeignSchema = mysqlImportForeignSchema;
 #endif
 
+#if PG_VERSION_NUM >= 90600
+	/* Support functions for parallel scans */
+	fdwroutine->IsForeignScanParallelSafe = mysqlIsForeignScanParallelSafe;
+	fdwroutine->EstimateDSMForeignScan = mysqlEstimateDSMForeignScan;
+	fdwroutine->InitializeDSMForeignScan = mysqlInitializeDSMForeignScan;
+#if PG_VERSION_NUM >= 100000
+	fdwroutine->ReInitializeDSMForeignScan = mysqlReInitializeDSMForeignScan;
+#endif
+	fdwroutine->InitializeWorkerForeignScan = mysqlInitializeWorkerForeignScan;
+#endif
+
+#if PG_VERSION_NUM >= 140000
+	/* Support functions for asynchronous execution */
+	fdwroutine->IsForeignPathAsyncCapable = mysqlIsForeignPathAsyncCapable;
+	fdwroutine->ForeignAsyncRequest = mysqlForeignAsyncRequest;
+	fdwroutine->ForeignAsyncConfigureWait = mysqlForeignAsyncConfigureWait;
+	fdwroutine->ForeignAsyncNotify = mysqlForeignAsyncNotify;
+#endif
+
 	/* Callback functions for writeable FDW */
 	fdwroutine->ExecForeignInsert = mysqlExecForeignInsert;
 	fdwroutine->BeginForeignModify = mysqlBeginForeignModify;
@@ -388,50 +719,102 @@ mysqlBeginForeignScan(ForeignScanState *node, int eflags)
 	mysql_opt         *options;
 	ListCell          *lc = NULL;
 	int               atindex = 0;
-	unsigned long     prefetch_rows = MYSQL_PREFETCH_ROWS;
+	int               i;
+	unsigned long     row_width = 0;
 	unsigned long     type = (unsigned long) CURSOR_TYPE_READ_ONLY;
 	Oid               userid;
 	ForeignServer     *server;
 	UserMapping       *user;
 	ForeignTable      *table;
+	Index             rtindex;
 	char              timeout[255];
 	int               numParams;
+	int               nbinds;
+	bool              charset_match;
 	List *tlist;
 	/*
 	 * We'll save private state in node->fdw_state.
 	 */
-	festate = (MySQLFdwExecState *) palloc(sizeof(MySQLFdwExecState));
+	festate = (MySQLFdwExecState *) palloc0(sizeof(MySQLFdwExecState));
 	node->fdw_state = (void *) festate;
+	festate->scan_state = (PlanState *) node;
 
 	/*
 	 * Identify which user to do the remote access as.  This should match what
-	 * ExecCheckRTEPerms() does.
+	 * ExecCheckRTEPerms() does.  A pushed down join has no scan relation;
+	 * all of its tables share the server and user mapping, so any of them
+	 * will do.
 	 */
-	rte = rt_fetch(fsplan->scan.scanrelid, estate->es_range_table);
+	rtindex = fsplan->scan.scanrelid;
+#if PG_VERSION_NUM >= 90600
+	if (rtindex == 0)
+		rtindex = bms_next_member(fsplan->fs_relids, -1);
+#endif
+	rte = rt_fetch(rtindex, estate->es_range_table);
 	userid = rte->checkAsUser ? rte->checkAsUser : GetUserId();
 
 	/* Get info about foreign table. */
 	festate->rel = node->ss.ss_currentRelation;
-	table = GetForeignTable(RelationGetRelid(festate->rel));
+	table = GetForeignTable(rte->relid);
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(userid, server->serverid);
 
 	/* Fetch the options */
-	options = mysql_get_options(RelationGetRelid(node->ss.ss_currentRelation));
+	options = mysql_get_options(rte->relid);
+	festate->mysqlFdwOptions = options;
 
 	/*
 	 * Get the already connected connection, otherwise connect
-	 * and get the connection handle.
+	 * and get the connection handle.  Compression pays off for scans
+	 * expected to read enough to be worth the CPU time.
 	 */
-	conn = mysql_get_connection(server, user, options);
+	conn = mysql_get_connection(server, user, options,
+								fsplan->scan.plan.plan_rows * fsplan->scan.plan.plan_width >=
+								options->compression_threshold * 1024.0);
 
 	/* Stash away the state info we have already */
-	festate->query = strVal(list_nth(fsplan->fdw_private, 0));
-	festate->retrieved_attrs = list_nth(fsplan->fdw_private, 1);
-
-	festate->is_tlist_pushdown = intVal(list_nth(fsplan->fdw_private, 2));
+	festate->query = strVal(list_nth(fsplan->fdw_private, FdwScanPrivateSelectSql));
+	festate->retrieved_attrs = list_nth(fsplan->fdw_private, FdwScanPrivateRetrievedAttrs);
+
+	festate->is_tlist_pushdown = intVal(list_nth(fsplan->fdw_private, FdwScanPrivateTlistPushdown));
+	festate->fetch_mode = (MySQLFetchMode) intVal(list_nth(fsplan->fdw_private, FdwScanPrivateFetchMode));
+	festate->bounds_query = strVal(list_nth(fsplan->fdw_private, FdwScanPrivateBoundsSql));
+	festate->limit_param = linitial_int((List *) list_nth(fsplan->fdw_private,
+														   FdwScanPrivateLimitParams));
+	festate->offset_param = lsecond_int((List *) list_nth(fsplan->fdw_private,
+														   FdwScanPrivateLimitParams));
+	festate->lookup_attnum = linitial_int((List *) list_nth(fsplan->fdw_private,
+															FdwScanPrivateLookupKey));
+	festate->lookup_batch = lsecond_int((List *) list_nth(fsplan->fdw_private,
+														  FdwScanPrivateLookupKey));
+	festate->remote_access = strVal(list_nth(fsplan->fdw_private, FdwScanPrivateRemoteAccess));
+	festate->parallel = (festate->bounds_query[0] != '\0');
 	festate->conn = conn;
-	festate->cursor_exists = false;
+	festate->params_bound = false;
+	festate->params_known = false;
+	festate->max_blob_size = options->max_blob_size;
+
+	/* The GUC, when set, overrides the fetch_size option */
+	if (fetch_size_override > 0)
+	{
+		festate->fetch_size = (unsigned long) fetch_size_override;
+		festate->fetch_adaptive = false;
+	}
+	else
+	{
+		festate->fetch_size = options->fetch_size;
+		festate->fetch_adaptive = options->fetch_adaptive;
+	}
+	festate->batch.size = options->batch_size;
+
+#if PG_VERSION_NUM >= 140000 && defined(MYSQL_FDW_NONBLOCK)
+	/*
+	 * Under an asynchronous Append the rows are asked for through requests,
+	 * which must not wait for MySQL.  A buffered scan has its rows at hand.
+	 */
+	festate->async_mode = node->ss.ps.async_capable &&
+		festate->fetch_mode != MYSQL_FETCH_BUFFERED;
+#endif
 
 	festate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
 											  "mysql_fdw temporary data",
@@ -443,6 +826,18 @@ mysqlBeginForeignScan(ForeignScanState *node, int eflags)
 											  ALLOCSET_SMALL_MAXSIZE);
 #endif
 
+#ifdef MYSQL_FDW_NONBLOCK
+	/* Drop the connection if the scan goes away with a fetch in flight */
+	if (_mysql_stmt_fetch_start != NULL)
+	{
+		MemoryContextCallback *callback = palloc0(sizeof(MemoryContextCallback));
+
+		callback->func = mysql_scan_reset_callback;
+		callback->arg = (void *) festate;
+		MemoryContextRegisterResetCallback(estate->es_query_cxt, callback);
+	}
+#endif
+
 	if (wait_timeout > 0)
 	{
 		/* Set the session timeout in seconds*/
@@ -502,35 +897,70 @@ mysqlBeginForeignScan(ForeignScanState *node, int eflags)
 		}
 	}
 
-	/* Prepare for output conversion of parameters used in remote query. */
+	/* Prepare for binding the parameters used in remote query. */
 	numParams = list_length(fsplan->fdw_exprs);
 	festate->numParams = numParams;
 	if (numParams > 0)
 		prepare_query_params((PlanState *) node,
-							 fsplan->fdw_exprs,
-							 numParams,
-							 &festate->param_flinfo,
-							 &festate->param_exprs,
-							 &festate->param_values,
-							 &festate->param_types);
+							 festate,
+							 fsplan->fdw_exprs);
 
 	/*
-	 * If this is the first call after Begin or ReScan, we need to create the
-	 * cursor on the remote side.
+	 * The bind array stays in place for the life of the scan, so rescans
+	 * only fill in the values that changed.  The key range of a parallel
+	 * scan comes last, from the chunk being read, as do the keys a lookup
+	 * asks for after its own.
 	 */
-	if (!festate->cursor_exists)
-		create_cursor(node);
+	nbinds = numParams + (festate->parallel ? 2 : 0) +
+		(festate->lookup_batch > 0 ? festate->lookup_batch - 1 : 0);
+	StaticAssertStmt((MYSQL_MAX_LOOKUP_KEYS + 2) * sizeof(MYSQL_BIND) <= MaxAllocSize,
+					 "the bind array of a lookup must fit in a palloc chunk");
+	if (nbinds > 0)
+	{
+		festate->param_binds = (MYSQL_BIND *) palloc0(sizeof(MYSQL_BIND) * nbinds);
+		if (festate->lookup_batch > 0)
+			festate->lookup_keys = (long long *) palloc0(sizeof(long long) * (festate->lookup_batch - 1));
+		for (i = numParams; i < nbinds; i++)
+		{
+			festate->param_binds[i].buffer_type = MYSQL_TYPE_LONGLONG;
+			if (festate->parallel)
+				festate->param_binds[i].buffer = (void *) &festate->range[i - numParams];
+			else
+			{
+				/* A NULL key matches nothing, the other keys go with it */
+				festate->param_binds[i].buffer = (void *) &festate->lookup_keys[i - numParams];
+				festate->param_binds[i].is_null = &festate->param_nulls[0];
+			}
+		}
+	}
+	if (festate->lookup_batch > 0)
+		festate->lookup_type = TupleDescAttr(tupleDescriptor, festate->lookup_attnum - 1)->atttypid;
 
     /* int column_count = mysql_num_fields(festate->meta); */
 
+	/*
+	 * Only cursor scans leave the result on the server between fetches.  The
+	 * other modes read it off the connection as the server sends it.
+	 */
+	if (festate->fetch_mode != MYSQL_FETCH_CURSOR)
+		type = (unsigned long) CURSOR_TYPE_NO_CURSOR;
+
 	/* Set the statement as cursor type */
 	_mysql_stmt_attr_set(festate->stmt, STMT_ATTR_CURSOR_TYPE, (void*) &type);
 
-	/* Set the pre-fetch rows */
-	_mysql_stmt_attr_set(festate->stmt, STMT_ATTR_PREFETCH_ROWS, (void*) &prefetch_rows);
+	/* Buffered scans keep the rows locally, spilling to disk past work_mem */
+	if (festate->fetch_mode == MYSQL_FETCH_BUFFERED)
+	{
+		festate->store = tuplestore_begin_heap(false, false, work_mem);
+#if PG_VERSION_NUM >= 120000
+		/* The scan slot cannot hold the minimal tuples of the store */
+		festate->store_slot = MakeSingleTupleTableSlot(tupleDescriptor, &TTSOpsMinimalTuple);
+#endif
+	}
 
 	festate->table = (mysql_table*) palloc0(sizeof(mysql_table));
 	festate->table->column = (mysql_column *) palloc0(sizeof(mysql_column) * tupleDescriptor->natts);
+	festate->table->converter = (mysql_converter *) palloc0(sizeof(mysql_converter) * tupleDescriptor->natts);
 	festate->table->_mysql_bind = (MYSQL_BIND*) palloc0(sizeof(MYSQL_BIND) * tupleDescriptor->natts);
 
 	festate->table->_mysql_res = _mysql_stmt_result_metadata(festate->stmt);
@@ -544,6 +974,9 @@ mysqlBeginForeignScan(ForeignScanState *node, int eflags)
 
     festate->table->_mysql_fields = _mysql_fetch_fields(festate->table->_mysql_res);
 
+	/* Text MySQL sends in the database encoding need not be checked again */
+	charset_match = mysql_charset_matches(festate->conn);
+
 	if (festate->is_tlist_pushdown)
 		tlist = node->ss.ps.plan->targetlist;
 	else
@@ -568,9 +1001,50 @@ mysqlBeginForeignScan(ForeignScanState *node, int eflags)
 		festate->table->column[atindex]._mysql_bind = &festate->table->_mysql_bind[atindex];
 
 		mysql_bind_result(pgtype, pgtypmod, &festate->table->_mysql_fields[atindex],
-							&festate->table->column[atindex]);
+							&festate->table->column[atindex], festate->max_blob_size,
+							charset_match);
+
+		/* Resolve the conversion of this column once for the whole scan */
+		festate->table->converter[atindex].attnum = attnum;
+		festate->type_lookups += mysql_init_converter(pgtype,
+													  &festate->table->column[atindex],
+													  &festate->table->converter[atindex]);
+		row_width += festate->table->_mysql_bind[atindex].buffer_length;
 		atindex++;
 	}
+	festate->table->ncolumns = atindex;
+
+	/* Check selective local conditions before converting the other columns */
+	mysql_setup_late_qual(node, festate);
+
+	/*
+	 * Rescans may be answered with the rows of an earlier one, unless they
+	 * read chunks of a parallel scan, or the rows are filtered by local
+	 * conditions whose parameters are not part of the remote query.
+	 */
+	festate->cache_ok = !festate->parallel &&
+		!(festate->late_qual != NULL &&
+		  mysql_contain_param_walker((Node *) node->ss.ps.plan->qual, NULL));
+
+	/* Staging area for a batch of converted rows, column by column */
+	festate->batch.values = (Datum **) palloc(sizeof(Datum *) * atindex);
+	festate->batch.isnull = (bool **) palloc(sizeof(bool *) * atindex);
+	for (i = 0; i < atindex; i++)
+	{
+		festate->batch.values[i] = (Datum *) palloc(sizeof(Datum) * festate->batch.size);
+		festate->batch.isnull[i] = (bool *) palloc(sizeof(bool) * festate->batch.size);
+	}
+
+	/*
+	 * An adaptive fetch starts small, for a fast first row, and doubles on
+	 * each round trip until a batch of bound rows fills work_mem.
+	 */
+	if (festate->fetch_adaptive)
+		festate->fetch_max = Max((work_mem * 1024L) / Max(row_width, 1), MYSQL_FETCH_MIN);
+
+	/* Set the pre-fetch rows */
+	festate->fetch_left = festate->fetch_size;
+	_mysql_stmt_attr_set(festate->stmt, STMT_ATTR_PREFETCH_ROWS, (void*) &festate->fetch_size);
 
 	/* Bind the results pointers for the prepare statements */
 	if (_mysql_stmt_bind_result(festate->stmt, festate->table->_mysql_bind) != 0)
@@ -604,41 +1078,38 @@ mysqlBeginForeignScan(ForeignScanState *node, int eflags)
 		}
 	}
 	/*
-	 * Finally execute the query and result will be placed in the
-	 * array we already bind
+	 * The query is executed when the first row is asked for, so that it
+	 * does not hold the connection while the other scans of the query are
+	 * set up.  A parallel scan executes it once it has a chunk of keys to
+	 * read.
 	 */
-	if (_mysql_stmt_execute(festate->stmt) != 0)
+	if (festate->parallel)
 	{
-		switch(_mysql_stmt_errno(festate->stmt))
-		{
-			case CR_NO_ERROR:
-				break;
-
-			case CR_OUT_OF_MEMORY:
-			case CR_SERVER_GONE_ERROR:
-			case CR_SERVER_LOST:
-			{
-				char *err = pstrdup(_mysql_error(festate->conn));
-				mysql_rel_connection(festate->conn);
-				ereport(ERROR,
-							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-							errmsg("failed to execute the MySQL query: \n%s", err)));
-			}
-			break;
-			case CR_COMMANDS_OUT_OF_SYNC:
-			case CR_UNKNOWN_ERROR:
-			default:
-			{
-				char *err = pstrdup(_mysql_error(festate->conn));
-				ereport(ERROR,
-							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-							errmsg("failed to execute the MySQL query: \n%s", err)));
-			}
-			break;
-		}
+		festate->batch.done = true;
+		festate->scan_started = true;
 	}
 }
 
+/*
+ * mysql_charset_matches: Tell whether the connection charset is the
+ * database encoding, in which case MySQL has converted the text it sends
+ * into valid strings of that encoding already.
+ */
+static bool
+mysql_charset_matches(MYSQL *conn)
+{
+	const char *charset = _mysql_character_set_name(conn);
+
+	if (charset == NULL)
+		return false;
+
+	/* utf8, utf8mb3 and utf8mb4 are all UTF-8 */
+	if (GetDatabaseEncoding() == PG_UTF8)
+		return pg_strncasecmp(charset, "utf8", 4) == 0;
+
+	return pg_strcasecmp(charset, GetDatabaseEncodingName()) == 0;
+}
+
 /*
  * mysqlIterateForeignScan: Iterate and get the rows one by one from
  * MySQL and placed in tuple slot
@@ -648,446 +1119,4053 @@ mysqlIterateForeignScan(ForeignScanState *node)
 {
 	MySQLFdwExecState   *festate = (MySQLFdwExecState *) node->fdw_state;
 	TupleTableSlot      *tupleSlot = node->ss.ss_ScanTupleSlot;
-	TupleDesc           tupleDescriptor = tupleSlot->tts_tupleDescriptor;
-	int                 attid = 0;
-	ListCell            *lc = NULL;
-	int                 rc = 0;
 
-	memset (tupleSlot->tts_values, 0, sizeof(Datum) * tupleDescriptor->natts);
-	memset (tupleSlot->tts_isnull, true, sizeof(bool) * tupleDescriptor->natts);
+	/* The values of the parameters are only known now */
+	if (!festate->params_bound)
+		mysql_bind_scan(node);
 
-	ExecClearTuple(tupleSlot);
+	if (!festate->scan_started)
+		mysql_start_scan(festate);
 
-	attid = 0;
-	rc = _mysql_stmt_fetch(festate->stmt);
-	if (0 == rc)
+	/* A rescan answered with the rows kept of an earlier one */
+	if (festate->cache_read != NULL)
 	{
-		List *tlist;
-		if (festate->is_tlist_pushdown)
-			tlist = node->ss.ps.plan->targetlist;
+		mysql_cache_next(festate, tupleSlot);
+		return tupleSlot;
+	}
+
+	if (festate->fetch_mode == MYSQL_FETCH_BUFFERED)
+	{
+		/* Drain the whole result on the first call, then read it locally */
+		if (!festate->store_filled)
+			mysql_fill_tuplestore(festate, tupleSlot);
+
+#if PG_VERSION_NUM >= 120000
+		if (tuplestore_gettupleslot(festate->store, true, false, festate->store_slot))
+			ExecCopySlot(tupleSlot, festate->store_slot);
 		else
-			tlist = festate->retrieved_attrs;
+			ExecClearTuple(tupleSlot);
+#else
+		tuplestore_gettupleslot(festate->store, true, false, tupleSlot);
+#endif
+		if (festate->cache_fill != NULL)
+			mysql_cache_collect(festate, tupleSlot, true);
+		return tupleSlot;
+	}
 
-		foreach(lc, tlist)
+#if PG_VERSION_NUM >= 90600
+	/* A parallel scan reads one chunk of the key range after the other */
+	if (festate->parallel)
+	{
+		while (!mysql_next_tuple(festate, tupleSlot))
 		{
-			int attnum;
-			Oid pgtype;
-			int32 pgtypmod;
-			if (festate->is_tlist_pushdown)
-				attnum = attid;
-			else
-				attnum = lfirst_int(lc) - 1;
-			pgtype = TupleDescAttr(tupleDescriptor, attnum)->atttypid;
-			pgtypmod = TupleDescAttr(tupleDescriptor, attnum)->atttypmod;
-
-			tupleSlot->tts_isnull[attnum] = festate->table->column[attid].is_null;
-			if (!festate->table->column[attid].is_null)
-				tupleSlot->tts_values[attnum] = mysql_convert_to_pg(pgtype, pgtypmod,
-                                                                    &festate->table->column[attid]);
-			attid++;
+			if (!mysql_next_range(festate))
+				break;
 		}
-		ExecStoreVirtualTuple(tupleSlot);
-	}
-	else if (1 == rc)
-	{
-			/*
-			  Error occurred. Error code and message can be obtained
-			  by calling mysql_stmt_errno() and mysql_stmt_error().
-			*/
-	}
-	else if (MYSQL_NO_DATA == rc)
-	{
-            /*
-              No more rows/data exists
-            */
-	}
-	else if (MYSQL_DATA_TRUNCATED == rc)
-	{
-            /* Data truncation occurred */
-            /*
-              MYSQL_DATA_TRUNCATED is returned when truncation
-              reporting is enabled. To determine which column values
-              were truncated when this value is returned, check the
-              error members of the MYSQL_BIND structures used for
-              fetching values. Truncation reporting is enabled by
-              default, but can be controlled by calling
-              mysql_options() with the MYSQL_REPORT_DATA_TRUNCATION
-              option.
-            */
+		return tupleSlot;
 	}
+#endif
+
+	mysql_next_tuple(festate, tupleSlot);
+	if (festate->cache_fill != NULL)
+		mysql_cache_collect(festate, tupleSlot, festate->batch.done);
 	return tupleSlot;
 }
 
-
 /*
- * mysqlExplainForeignScan: Produce extra output for EXPLAIN
+ * mysql_next_tuple: Store the next row of the scan in tupleSlot, fetching
+ * a new batch once the current one is used up.
+ *
+ * Returns false, leaving the slot empty, once there are no more rows.
  */
-static void
-mysqlExplainForeignScan(ForeignScanState *node, ExplainState *es)
+static bool
+mysql_next_tuple(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot)
 {
-	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
-	mysql_opt *options;
+	mysql_batch *batch = &festate->batch;
+	mysql_table *table = festate->table;
+	int         row;
+	int         i;
 
-	/* Fetch options */
-	options = mysql_get_options(RelationGetRelid(node->ss.ss_currentRelation));
+	ExecClearTuple(tupleSlot);
 
-	/* Give some possibly useful info about startup costs */
-	if (es->verbose)
+	while (batch->next >= batch->nrows)
 	{
-		if (strcmp(options->svr_address, "127.0.0.1") == 0 || strcmp(options->svr_address, "localhost") == 0)
-#if PG_VERSION_NUM >= 110000
-			ExplainPropertyInteger("Local server startup cost", NULL, 10, es);
-#else
-			ExplainPropertyLong("Local server startup cost", 10, es);
-#endif
-		else
-#if PG_VERSION_NUM >= 110000
-			ExplainPropertyInteger("Remote server startup cost", NULL, 25, es);
-#else
-			ExplainPropertyLong("Remote server startup cost", 25, es);
-#endif
-		ExplainPropertyText("Remote query", festate->query, es);
-	}
-}
+		if (batch->done)
+			return false;
 
-/*
- * mysqlEndForeignScan: Finish scanning foreign table and dispose
- * objects used for this scan
- */
-static void
-mysqlEndForeignScan(ForeignScanState *node)
-{
-	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+		mysql_fetch_batch(festate);
 
-    if (festate->table)
-    {
-         if (festate->table->_mysql_res) {
-               _mysql_free_result(festate->table->_mysql_res);
-               festate->table->_mysql_res = NULL;
-         }
-       }
+		/* Nothing arrived yet; a batch filtered out whole is followed by the next */
+		if (batch->nfetched == 0)
+			return false;
+	}
+	row = batch->next++;
 
-	if (festate->stmt)
+	/* Attributes that are not retrieved stay null */
+	if (table->ncolumns < tupleSlot->tts_tupleDescriptor->natts)
+		memset(tupleSlot->tts_isnull, true, sizeof(bool) * tupleSlot->tts_tupleDescriptor->natts);
+
+	for (i = 0; i < table->ncolumns; i++)
 	{
-		_mysql_stmt_close(festate->stmt);
-		festate->stmt = NULL;
+		int attnum = table->converter[i].attnum;
+
+		tupleSlot->tts_isnull[attnum] = batch->isnull[i][row];
+		tupleSlot->tts_values[attnum] = batch->values[i][row];
 	}
+	ExecStoreVirtualTuple(tupleSlot);
+	return true;
 }
 
 /*
- * mysqlReScanForeignScan: Rescan table, possibly with new parameters
+ * mysql_fetch_batch: Fetch up to a batch worth of rows of the statement,
+ * converting their values into the staging area of the scan.
+ *
+ * The values of the previous batch, which have all been returned by now,
+ * are released.
  */
 static void
-mysqlReScanForeignScan(ForeignScanState *node)
+mysql_fetch_batch(MySQLFdwExecState *festate)
 {
-        MySQLFdwExecState  *festate = (MySQLFdwExecState *) node->fdw_state;
-	if (_mysql_stmt_execute(festate->stmt) != 0)
+	mysql_batch   *batch = &festate->batch;
+	mysql_table   *table = festate->table;
+	MemoryContext oldcontext;
+	int           nrows = 0;
+	int           nfetched = 0;
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* Another scan may be using the connection for its next rows */
+	if (mysql_get_pending_scan(festate->conn) != festate &&
+		mysql_get_streaming_scan(festate->conn) != festate)
+		mysql_finish_pending_fetch(festate->conn);
+
+	/* The values of the previous batch go, note how much memory they took */
+	mysql_track_memory(festate);
+	MemoryContextReset(festate->temp_cxt);
+#if PG_VERSION_NUM < 130000
+	festate->batch_bytes = 0;
+#endif
+	oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+
+	/* Rows filtered out count too, the memory of their values is only freed here */
+	while (nfetched < batch->size)
 	{
-		switch(_mysql_stmt_errno(festate->stmt))
+		int rc;
+		int i;
+
+#ifdef MYSQL_FDW_NONBLOCK
+		/* An asynchronous scan stops at the first row that is not there yet */
+		if (festate->async_mode && !mysql_fetch_ready(festate))
+			break;
+#endif
+
+		/* Values of the previous row fetched on their own stay with its datums */
+		if (table->spilled)
 		{
-			case CR_NO_ERROR:
-				break;
+			for (i = 0; i < table->ncolumns; i++)
+				mysql_unspill_column(&table->column[i]);
+			table->spilled = false;
+		}
 
-			case CR_OUT_OF_MEMORY:
-			case CR_SERVER_GONE_ERROR:
-			case CR_SERVER_LOST:
-			{
-				char *err = pstrdup(_mysql_error(festate->conn));
-				mysql_rel_connection(festate->conn);
-				ereport(ERROR,
-							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-							errmsg("failed to execute the MySQL query: \n%s", err)));
-			}
+		rc = mysql_fetch_row(festate);
+		if (MYSQL_DATA_TRUNCATED == rc)
+		{
+			/* Some values did not fit their bind buffers, fetch the rest of them */
+			mysql_fetch_overflow(festate);
+			rc = 0;
+		}
+
+		/* No more rows/data exists */
+		if (MYSQL_NO_DATA == rc)
+		{
+			batch->done = true;
+			mysql_end_streaming(festate);
 			break;
-			case CR_COMMANDS_OUT_OF_SYNC:
-			case CR_UNKNOWN_ERROR:
-			default:
+		}
+
+		if (0 != rc)
+			mysql_stmt_error_report(festate, "failed to fetch the MySQL result");
+
+		/* The next fetch goes to the server, ask it for a larger batch */
+		if (festate->fetch_adaptive && --festate->fetch_left == 0)
+		{
+			festate->fetch_size = Min(festate->fetch_size * 2, festate->fetch_max);
+			festate->fetch_left = festate->fetch_size;
+			_mysql_stmt_attr_set(festate->stmt, STMT_ATTR_PREFETCH_ROWS,
+								 (void*) &festate->fetch_size);
+		}
+
+		nfetched++;
+
+		/* Check the local conditions first, on the columns they need */
+		if (festate->late_qual != NULL && !mysql_row_qualifies(festate, nrows))
+		{
+			InstrCountFiltered1(festate->scan_state, 1);
+			continue;
+		}
+
+		for (i = 0; i < table->ncolumns; i++)
+		{
+			mysql_column *column = &table->column[i];
+
+			if (festate->late_qual != NULL && table->converter[i].in_qual)
+				continue;
+
+			batch->isnull[i][nrows] = column->is_null;
+			if (!column->is_null)
 			{
-				char *err = pstrdup(_mysql_error(festate->conn));
-				ereport(ERROR,
-							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-							errmsg("failed to execute the MySQL query: \n%s", err)));
+				batch->values[i][nrows] = mysql_convert_to_pg(&table->converter[i], column);
+#if PG_VERSION_NUM < 130000
+				festate->batch_bytes += column->length;
+#endif
 			}
-			break;
 		}
+		nrows++;
 	}
-        return;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	batch->nrows = nrows;
+	batch->nfetched = nfetched;
+	batch->next = 0;
+
+#ifdef MYSQL_FDW_NONBLOCK
+	/* Ask for the next rows now, they travel while this batch is consumed */
+	if (!batch->done && _mysql_stmt_fetch_start != NULL &&
+		festate->fetch_mode != MYSQL_FETCH_BUFFERED)
+		mysql_fetch_ready(festate);
+#endif
 }
 
+#ifdef MYSQL_FDW_NONBLOCK
 /*
- * mysqlGetForeignRelSize: Create a FdwPlan for a scan on the foreign table
+ * mysql_fetch_ready: Start fetching the next row without waiting for it,
+ * unless that is already done, and tell whether the row has arrived.
+ */
+static bool
+mysql_fetch_ready(MySQLFdwExecState *festate)
+{
+	if (!festate->fetch_pending)
+	{
+		festate->async_status = _mysql_stmt_fetch_start(&festate->async_ret, festate->stmt);
+		festate->fetch_pending = true;
+		if (festate->async_status != 0)
+			mysql_set_pending_scan(festate->conn, festate);
+	}
+	return festate->async_status == 0;
+}
+#endif
+
+/*
+ * mysql_fetch_row: Fetch the next row of the scan into the bind buffers,
+ * completing the fetch started ahead of time if there is one.
+ */
+static int
+mysql_fetch_row(MySQLFdwExecState *festate)
+{
+#ifdef MYSQL_FDW_NONBLOCK
+	if (festate->fetch_pending)
+	{
+		festate->fetch_pending = false;
+		return mysql_async_finish(festate, festate->async_status, &festate->async_ret,
+								  _mysql_stmt_fetch_cont);
+	}
+#endif
+	return _mysql_stmt_fetch(festate->stmt);
+}
+
+/*
+ * mysql_row_qualifies: Convert the columns of the fetched row that the
+ * local conditions need into the given row of the batch, and check them.
+ *
+ * The executor checks them again on the rows that pass, which is why
+ * this is only done for conditions without volatile functions.
+ */
+static bool
+mysql_row_qualifies(MySQLFdwExecState *festate, int row)
+{
+	ExprContext    *econtext = festate->scan_state->ps_ExprContext;
+	TupleTableSlot *slot = ((ScanState *) festate->scan_state)->ss_ScanTupleSlot;
+	mysql_batch    *batch = &festate->batch;
+	mysql_table    *table = festate->table;
+	int            i;
+
+	ExecClearTuple(slot);
+	memset(slot->tts_isnull, true, sizeof(bool) * slot->tts_tupleDescriptor->natts);
+
+	for (i = 0; i < table->ncolumns; i++)
+	{
+		mysql_converter *conv = &table->converter[i];
+		mysql_column    *column = &table->column[i];
+
+		if (!conv->in_qual)
+			continue;
+
+		batch->isnull[i][row] = column->is_null;
+		if (!column->is_null)
+			batch->values[i][row] = mysql_convert_to_pg(conv, column);
+
+		slot->tts_isnull[conv->attnum] = batch->isnull[i][row];
+		slot->tts_values[conv->attnum] = batch->values[i][row];
+	}
+	ExecStoreVirtualTuple(slot);
+
+	/* The executor resets the context before each row it asks for anyway */
+	ResetExprContext(econtext);
+	econtext->ecxt_scantuple = slot;
+
+#if PG_VERSION_NUM >= 100000
+	return ExecQual(festate->late_qual, econtext);
+#else
+	return ExecQual(festate->late_qual, econtext, false);
+#endif
+}
+
+/*
+ * mysql_setup_late_qual: Arrange for the local conditions of the scan to
+ * be checked as soon as a row is fetched, so that the columns only the
+ * output needs are converted for the rows that pass only.
+ *
+ * This is not done when the conditions may give another answer when
+ * checked again, refer to system columns or the whole row, or when they
+ * need every column anyway.  Nor for buffered scans, whose rows may be
+ * read again with other parameter values, or with a pushed down target
+ * list, which the conditions do not refer to by attribute number.
  */
 static void
-mysqlGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+mysql_setup_late_qual(ForeignScanState *node, MySQLFdwExecState *festate)
 {
-	StringInfoData       sql;
-	double               rows = 0;
-	double               filtered = 0;
-	MYSQL                *conn = NULL;
-	MYSQL_RES            *result = NULL;
-	MYSQL_ROW            row;
-	Bitmapset            *attrs_used = NULL;
-	List                 *retrieved_attrs = NULL;
-	mysql_opt            *options = NULL;
-	Oid                  userid =  GetUserId();
-	ForeignServer        *server;
-	UserMapping          *user;
-	ForeignTable         *table;
+	List      *quals = node->ss.ps.plan->qual;
+	Index     scanrelid = ((Scan *) node->ss.ps.plan)->scanrelid;
+	Bitmapset *attrs = NULL;
+	Bitmapset *tmp;
+	bool      deferred = false;
+	int       x;
+	int       i;
+
+	if (quals == NIL || festate->is_tlist_pushdown || scanrelid == 0 ||
+		festate->fetch_mode == MYSQL_FETCH_BUFFERED ||
+		contain_volatile_functions((Node *) quals))
+		return;
+
+	pull_varattnos((Node *) quals, scanrelid, &attrs);
+
+	tmp = bms_copy(attrs);
+	while ((x = bms_first_member(tmp)) >= 0)
+	{
+		if (x + FirstLowInvalidHeapAttributeNumber <= 0)
+			return;
+	}
+
+	for (i = 0; i < festate->table->ncolumns; i++)
+	{
+		mysql_converter *conv = &festate->table->converter[i];
+
+		conv->in_qual = bms_is_member(conv->attnum + 1 - FirstLowInvalidHeapAttributeNumber, attrs);
+		if (!conv->in_qual)
+			deferred = true;
+	}
+
+	if (!deferred)
+		return;
+
+	/* The rows that pass are not checked again by ExecScan */
+	festate->late_qual = node->ss.ps.qual;
+	node->ss.ps.qual = NULL;
+}
+
+/*
+ * mysql_fill_tuplestore: Read the whole result of a buffered scan into its
+ * tuplestore, releasing the connection for other statements.
+ */
+static void
+mysql_fill_tuplestore(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot)
+{
+	while (mysql_next_tuple(festate, tupleSlot))
+		tuplestore_puttupleslot(festate->store, tupleSlot);
+
+	mysql_track_memory(festate);
+	MemoryContextReset(festate->temp_cxt);
+	festate->store_filled = true;
+}
+
+/*
+ * mysql_buffer_streaming: Read the rest of the result of a streaming scan
+ * into a tuplestore, for another statement to use the connection.  The
+ * scan goes on as a buffered one.
+ *
+ * The row the scan returned last may still be in use, so the memory of its
+ * values is left alone: the scan gets a new context for the other rows.
+ * The local conditions are given back to the executor, as checking them
+ * here would overwrite the scan slot.
+ */
+static void
+mysql_buffer_streaming(MySQLFdwExecState *festate)
+{
+	MemoryContext  query_cxt = MemoryContextGetParent(festate->temp_cxt);
+	TupleDesc      tupdesc = ((ScanState *) festate->scan_state)->ss_ScanTupleSlot->tts_tupleDescriptor;
+	TupleTableSlot *slot;
+	MemoryContext  oldcontext;
+
+	mysql_set_streaming_scan(festate->conn, NULL);
+	festate->fetch_mode = MYSQL_FETCH_BUFFERED;
+	festate->async_mode = false;
+	if (festate->late_qual != NULL)
+	{
+		festate->scan_state->qual = festate->late_qual;
+		festate->late_qual = NULL;
+	}
+
+	festate->temp_cxt = AllocSetContextCreate(query_cxt,
+											  "mysql_fdw temporary data",
+#if PG_VERSION_NUM >= 110000
+											  ALLOCSET_DEFAULT_SIZES);
+#else
+											  ALLOCSET_SMALL_MINSIZE,
+											  ALLOCSET_SMALL_INITSIZE,
+											  ALLOCSET_SMALL_MAXSIZE);
+#endif
+
+	oldcontext = MemoryContextSwitchTo(query_cxt);
+	festate->store = tuplestore_begin_heap(false, false, work_mem);
+#if PG_VERSION_NUM >= 120000
+	festate->store_slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsMinimalTuple);
+	slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+#else
+	slot = MakeSingleTupleTableSlot(tupdesc);
+#endif
+	MemoryContextSwitchTo(oldcontext);
+
+	mysql_fill_tuplestore(festate, slot);
+	festate->store_partial = true;
+	ExecDropSingleTupleTableSlot(slot);
+}
+
+/*
+ * mysql_contain_param_walker: Tell whether an expression refers to any
+ * parameter.
+ */
+static bool
+mysql_contain_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+		return true;
+	return expression_tree_walker(node, mysql_contain_param_walker, context);
+}
+
+/*
+ * Hash and comparison functions for the parameter values that identify a
+ * cached rescan result.
+ */
+static uint32
+mysql_cache_hash(const void *key, Size keysize)
+{
+	const MySQLCacheKey *k = (const MySQLCacheKey *) key;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) k->data, (int) k->len));
+}
+
+static int
+mysql_cache_match(const void *key1, const void *key2, Size keysize)
+{
+	const MySQLCacheKey *k1 = (const MySQLCacheKey *) key1;
+	const MySQLCacheKey *k2 = (const MySQLCacheKey *) key2;
+
+	if (k1->len != k2->len)
+		return 1;
+	return memcmp(k1->data, k2->data, k1->len);
+}
+
+/*
+ * mysql_cache_lookup: Look for the rows of an earlier rescan with the
+ * parameter values just bound.  When there are none, the rows of this scan
+ * are collected for the next rescans as they are returned.
+ *
+ * Returns true if the rescan is answered from the cache.
+ */
+static bool
+mysql_cache_lookup(ForeignScanState *node)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	MySQLCacheEntry   *entry;
+	bool              found;
+
+	/* The previous scan did not go through to the end of its rows */
+	if (festate->cache_fill != NULL)
+	{
+		mysql_cache_remove(festate, festate->cache_fill);
+		festate->cache_fill = NULL;
+	}
+	festate->cache_read = NULL;
+
+	if (!festate->cache_ok || !rescan_cache)
+		return false;
+
+	if (festate->cache == NULL)
+	{
+		HASHCTL ctl;
+
+		festate->cache_cxt = AllocSetContextCreate(node->ss.ps.state->es_query_cxt,
+												   "mysql_fdw rescan cache",
+#if PG_VERSION_NUM >= 110000
+												   ALLOCSET_DEFAULT_SIZES);
+#else
+												   ALLOCSET_DEFAULT_MINSIZE,
+												   ALLOCSET_DEFAULT_INITSIZE,
+												   ALLOCSET_DEFAULT_MAXSIZE);
+#endif
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(MySQLCacheKey);
+		ctl.entrysize = sizeof(MySQLCacheEntry);
+		ctl.hash = mysql_cache_hash;
+		ctl.match = mysql_cache_match;
+		ctl.hcxt = festate->cache_cxt;
+		festate->cache = hash_create("mysql_fdw rescan cache", 64, &ctl,
+									 HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+		dlist_init(&festate->cache_lru);
+
+#if PG_VERSION_NUM >= 120000
+		/* The scan slot cannot hold the minimal tuples of the cache */
+		festate->cache_slot = MakeSingleTupleTableSlot(node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+													   &TTSOpsMinimalTuple);
+#endif
+	}
+
+	entry = mysql_cache_search(node, festate->param_datums, festate->param_nulls,
+							   HASH_ENTER, &found);
+	if (found)
+	{
+		dlist_move_head(&festate->cache_lru, &entry->lru);
+		festate->cache_read = entry;
+		festate->cache_pos = 0;
+		festate->cache_hits++;
+		return true;
+	}
+
+	festate->cache_fill = entry;
+	festate->cache_misses++;
+	return false;
+}
+
+/*
+ * mysql_cache_search: Look for the result cached for the given parameter
+ * values.  With HASH_ENTER, an empty result is added if there is none.
+ */
+static MySQLCacheEntry *
+mysql_cache_search(ForeignScanState *node, Datum *values, bool *nulls,
+				   HASHACTION action, bool *found)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	ExprContext       *econtext = node->ss.ps.ps_ExprContext;
+	MemoryContext     oldcontext;
+	StringInfoData    buf;
+	MySQLCacheKey     key;
+	MySQLCacheEntry   *entry;
+	int               i;
+
+	/* The values of the parameters, one after the other, make the key */
+	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	initStringInfo(&buf);
+	for (i = 0; i < festate->numParams; i++)
+	{
+		Datum value = values[i];
+
+		appendStringInfoChar(&buf, nulls[i] ? 'n' : 'v');
+		if (nulls[i])
+			continue;
+
+		if (festate->param_typbyval[i])
+			appendBinaryStringInfo(&buf, (char *) &value, sizeof(Datum));
+		else
+			appendBinaryStringInfo(&buf, DatumGetPointer(value),
+								   datumGetSize(value, false, festate->param_typlen[i]));
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	key.data = buf.data;
+	key.len = buf.len;
+
+	entry = (MySQLCacheEntry *) hash_search(festate->cache, &key, action, found);
+	if (entry == NULL || *found)
+		return entry;
+
+	/* Keep the key past this call */
+	entry->key.data = MemoryContextAlloc(festate->cache_cxt, key.len + 1);
+	memcpy(entry->key.data, key.data, key.len);
+	entry->tuples = NULL;
+	entry->ntuples = 0;
+	entry->maxtuples = 0;
+	entry->size = sizeof(MySQLCacheEntry) + key.len;
+	entry->complete = false;
+	dlist_push_head(&festate->cache_lru, &entry->lru);
+
+	festate->cache_size += entry->size;
+	return entry;
+}
+
+/*
+ * mysql_cache_collect: Add the row just returned by a scan to the result
+ * being collected, or complete the result once there are no more rows.
+ *
+ * The least recently used results make room for it past work_mem.  The
+ * result is given up if it does not fit alone.
+ */
+static void
+mysql_cache_collect(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot, bool done)
+{
+	if (TupIsNull(tupleSlot))
+	{
+		/* No row yet is not the end of an asynchronous scan */
+		if (done)
+		{
+			festate->cache_fill->complete = true;
+			festate->cache_fill = NULL;
+		}
+		return;
+	}
+
+	if (!mysql_cache_add(festate, festate->cache_fill, tupleSlot))
+		festate->cache_fill = NULL;
+}
+
+/*
+ * mysql_cache_add: Add a row to a cached result.
+ *
+ * Returns false if the result had to go to make room for the row.
+ */
+static bool
+mysql_cache_add(MySQLFdwExecState *festate, MySQLCacheEntry *entry, TupleTableSlot *tupleSlot)
+{
+	Size            limit = (Size) work_mem * 1024L;
+	MemoryContext   oldcontext;
+	MinimalTuple    tuple;
+
+	oldcontext = MemoryContextSwitchTo(festate->cache_cxt);
+
+	if (entry->ntuples >= entry->maxtuples)
+	{
+		int newmax = Max(entry->maxtuples * 2, 16);
+
+		if (entry->tuples == NULL)
+			entry->tuples = (MinimalTuple *) palloc(sizeof(MinimalTuple) * newmax);
+		else
+			entry->tuples = (MinimalTuple *) repalloc(entry->tuples, sizeof(MinimalTuple) * newmax);
+		entry->size += sizeof(MinimalTuple) * (newmax - entry->maxtuples);
+		festate->cache_size += sizeof(MinimalTuple) * (newmax - entry->maxtuples);
+		entry->maxtuples = newmax;
+	}
+
+	tuple = ExecCopySlotMinimalTuple(tupleSlot);
+	entry->tuples[entry->ntuples++] = tuple;
+	entry->size += tuple->t_len;
+	festate->cache_size += tuple->t_len;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	while (festate->cache_size > limit)
+	{
+		MySQLCacheEntry *oldest = dlist_tail_element(MySQLCacheEntry, lru, &festate->cache_lru);
+
+		mysql_cache_remove(festate, oldest);
+		if (oldest == entry)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * mysql_lookup_batch: Look up the rows of the key just bound along with
+ * those of the keys that follow it and are not cached yet, in one round
+ * trip, and keep them in the rescan cache.  A nested loop driven by
+ * ordered or clustered keys asks for those next, and finds them there.
+ *
+ * Returns true if the rows of the key are then in the cache.  Otherwise
+ * the query is set up to ask for the rows of the key only.
+ */
+static bool
+mysql_lookup_batch(ForeignScanState *node)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	TupleTableSlot    *tupleSlot = node->ss.ss_ScanTupleSlot;
+	MySQLCacheEntry   *entry = festate->cache_fill;
+	int64             key;
+	int               nkeys = 0;
+	bool              found;
+	int               i;
+
+	/* Rows that cannot be kept are only fetched for the key asked for */
+	if (entry == NULL || festate->async_mode || festate->param_nulls[0])
+	{
+		mysql_lookup_one(festate);
+		return false;
+	}
+
+	/* The rows go to the results of their keys instead */
+	festate->cache_fill = NULL;
+	key = mysql_lookup_value(festate->param_types[0], festate->param_datums[0]);
+
+	/* Skip the keys cached already, without going too far */
+	for (i = 1; nkeys < festate->lookup_batch - 1 && i < 2 * festate->lookup_batch; i++)
+	{
+		if (key > PG_INT64_MAX - i)
+			break;
+		if (mysql_lookup_entry(node, key + i, HASH_ENTER, &found) == NULL)
+			break;
+		if (!found)
+			festate->lookup_keys[nkeys++] = key + i;
+	}
+	for (i = nkeys; i < festate->lookup_batch - 1; i++)
+		festate->lookup_keys[i] = key;
+
+	/* The key asked for is the last to make room for the others */
+	dlist_move_head(&festate->cache_lru, &entry->lru);
+
+	festate->batch.nrows = 0;
+	festate->batch.next = 0;
+	festate->batch.done = false;
+	festate->fetch_pending = false;
+	festate->fetch_left = festate->fetch_size;
+
+	if (mysql_execute_scan(festate) != 0)
+		mysql_stmt_error_report(festate, "failed to execute the MySQL query");
+	festate->lookup_batches++;
+
+	while (mysql_next_tuple(festate, tupleSlot))
+	{
+		MySQLCacheEntry *target;
+		bool            isnull;
+		Datum           value = slot_getattr(tupleSlot, festate->lookup_attnum, &isnull);
+
+		if (isnull)
+			continue;
+
+		target = mysql_lookup_entry(node, mysql_lookup_value(festate->lookup_type, value),
+									HASH_FIND, &found);
+		if (target != NULL && !target->complete)
+			mysql_cache_add(festate, target, tupleSlot);
+	}
+	ExecClearTuple(tupleSlot);
+	mysql_track_memory(festate);
+	MemoryContextReset(festate->temp_cxt);
+
+	/*
+	 * The results that were not given up are whole.  The keys that follow
+	 * may never be asked for, so those without rows are not kept: a sparse
+	 * key range would otherwise fill the cache with empty results and push
+	 * out the ones that are used.
+	 */
+	for (i = 0; i < nkeys; i++)
+	{
+		MySQLCacheEntry *done = mysql_lookup_entry(node, festate->lookup_keys[i],
+												   HASH_FIND, &found);
+
+		if (done == NULL)
+			continue;
+		if (done->ntuples == 0)
+			mysql_cache_remove(festate, done);
+		else
+			done->complete = true;
+	}
+
+	entry = mysql_lookup_entry(node, key, HASH_FIND, &found);
+	if (entry == NULL)
+	{
+		/* The rows of the key do not fit, fetch them again as they go */
+		mysql_lookup_one(festate);
+		return false;
+	}
+	entry->complete = true;
+
+	festate->cache_read = entry;
+	festate->cache_pos = 0;
+	return true;
+}
+
+/*
+ * mysql_lookup_one: Have the query of a scan that looks up several keys
+ * ask for the rows of the key bound only.
+ */
+static void
+mysql_lookup_one(MySQLFdwExecState *festate)
+{
+	long long key = 0;
+	int       i;
+
+	if (!festate->param_nulls[0])
+		key = mysql_lookup_value(festate->param_types[0], festate->param_datums[0]);
+
+	for (i = 0; i < festate->lookup_batch - 1; i++)
+		festate->lookup_keys[i] = key;
+}
+
+/*
+ * mysql_lookup_entry: Look for the cached result of a key of a scan that
+ * looks up several keys, as mysql_cache_search does.
+ *
+ * Returns NULL if the key is out of the range of the parameter type.
+ */
+static MySQLCacheEntry *
+mysql_lookup_entry(ForeignScanState *node, int64 key, HASHACTION action, bool *found)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	ExprContext       *econtext = node->ss.ps.ps_ExprContext;
+	MemoryContext     oldcontext;
+	Datum             value;
+	bool              isnull = false;
+
+	*found = false;
+	switch (festate->param_types[0])
+	{
+		case INT2OID:
+			if (key < PG_INT16_MIN || key > PG_INT16_MAX)
+				return NULL;
+			value = Int16GetDatum((int16) key);
+			break;
+		case INT4OID:
+			if (key < PG_INT32_MIN || key > PG_INT32_MAX)
+				return NULL;
+			value = Int32GetDatum((int32) key);
+			break;
+		default:
+			/* Passed by reference on 32-bit platforms */
+			oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+			value = Int64GetDatum(key);
+			MemoryContextSwitchTo(oldcontext);
+			break;
+	}
+
+	return mysql_cache_search(node, &value, &isnull, action, found);
+}
+
+/*
+ * mysql_lookup_value: Value of a lookup key of the given integer type.
+ */
+static int64
+mysql_lookup_value(Oid type, Datum value)
+{
+	switch (type)
+	{
+		case INT2OID:
+			return DatumGetInt16(value);
+		case INT4OID:
+			return DatumGetInt32(value);
+		default:
+			return DatumGetInt64(value);
+	}
+}
+
+/*
+ * mysql_cache_next: Store the next cached row of the rescan in tupleSlot,
+ * leaving it empty once there are no more.
+ */
+static void
+mysql_cache_next(MySQLFdwExecState *festate, TupleTableSlot *tupleSlot)
+{
+	MySQLCacheEntry *entry = festate->cache_read;
+
+	if (festate->cache_pos >= entry->ntuples)
+	{
+		ExecClearTuple(tupleSlot);
+		return;
+	}
+
+#if PG_VERSION_NUM >= 120000
+	ExecStoreMinimalTuple(entry->tuples[festate->cache_pos++], festate->cache_slot, false);
+	ExecCopySlot(tupleSlot, festate->cache_slot);
+#else
+	ExecStoreMinimalTuple(entry->tuples[festate->cache_pos++], tupleSlot, false);
+#endif
+}
+
+/*
+ * mysql_cache_remove: Drop a result from the cache.
+ */
+static void
+mysql_cache_remove(MySQLFdwExecState *festate, MySQLCacheEntry *entry)
+{
+	char *keydata = entry->key.data;
+	int  i;
+
+	for (i = 0; i < entry->ntuples; i++)
+		pfree(entry->tuples[i]);
+	if (entry->tuples != NULL)
+		pfree(entry->tuples);
+
+	dlist_delete(&entry->lru);
+	festate->cache_size -= entry->size;
+
+	hash_search(festate->cache, &entry->key, HASH_REMOVE, NULL);
+	pfree(keydata);
+}
+
+/*
+ * mysql_fetch_overflow: Complete the values of the current row that were
+ * truncated by their bind buffers.
+ *
+ * MYSQL_DATA_TRUNCATED is returned when truncation reporting is enabled,
+ * which is the default; the error members of the bound columns tell which
+ * values were cut.
+ */
+static void
+mysql_fetch_overflow(MySQLFdwExecState *festate)
+{
+	mysql_table *table = festate->table;
+	bool        rebind = false;
+	int         i;
+
+	for (i = 0; i < table->ncolumns; i++)
+	{
+		mysql_column *column = &table->column[i];
+
+		if (column->is_null || !column->error)
+			continue;
+
+		if (!mysql_fetch_truncated(festate->stmt, i, column, festate->max_blob_size, &rebind))
+			mysql_stmt_error_report(festate, "failed to fetch the MySQL result");
+		if (column->spill != (Datum) 0 || column->cut)
+			table->spilled = true;
+	}
+
+	/* Grown buffers take effect from the next row on */
+	if (rebind && _mysql_stmt_bind_result(festate->stmt, table->_mysql_bind) != 0)
+		mysql_stmt_error_report(festate, "failed to bind the MySQL query");
+}
+
+/*
+ * mysql_stmt_error_report: Report the last error of the scan statement,
+ * releasing the connection if it can no longer be used.
+ */
+static void
+mysql_stmt_error_report(MySQLFdwExecState *festate, const char *msg)
+{
+	char *err = pstrdup(_mysql_stmt_error(festate->stmt));
+
+	switch(_mysql_stmt_errno(festate->stmt))
+	{
+		case CR_OUT_OF_MEMORY:
+		case CR_SERVER_GONE_ERROR:
+		case CR_SERVER_LOST:
+			mysql_rel_connection(festate->conn);
+			break;
+
+		default:
+			break;
+	}
+
+	ereport(ERROR,
+				(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+				errmsg("%s: \n%s", msg, err)));
+}
+
+/*
+ * mysql_execute_scan: Execute the statement of the scan.  With the
+ * non-blocking API, query cancellation is honoured while MySQL works.
+ */
+static int
+mysql_execute_scan(MySQLFdwExecState *festate)
+{
+	int ret = 0;
+
+	mysql_end_streaming(festate);
+	mysql_finish_pending_fetch(festate->conn);
+
+#ifdef MYSQL_FDW_NONBLOCK
+	if (_mysql_stmt_execute_start != NULL)
+	{
+		int status = _mysql_stmt_execute_start(&ret, festate->stmt);
+
+		ret = mysql_async_finish(festate, status, &ret, _mysql_stmt_execute_cont);
+	}
+	else
+#endif
+		ret = _mysql_stmt_execute(festate->stmt);
+
+	/* Until the whole result is read, the connection can do nothing else */
+	if (ret == 0 && festate->fetch_mode == MYSQL_FETCH_STREAMING)
+		mysql_set_streaming_scan(festate->conn, festate);
+
+	return ret;
+}
+
+/*
+ * mysql_finish_pending_fetch: Complete the fetch a scan started ahead of
+ * time on conn, if any, so that the connection can be used for something
+ * else.  The scan finds the row in its bind buffers when it asks for it.
+ * The rest of a result being streamed goes to the tuplestore of its scan.
+ */
+void
+mysql_finish_pending_fetch(MYSQL *conn)
+{
+	MySQLFdwExecState *festate;
+
+#ifdef MYSQL_FDW_NONBLOCK
+	festate = mysql_get_pending_scan(conn);
+	if (festate != NULL)
+	{
+		mysql_async_finish(festate, festate->async_status, &festate->async_ret,
+						   _mysql_stmt_fetch_cont);
+		festate->async_status = 0;
+	}
+#endif
+
+	/* A streaming scan still reading its result reads the rest of it now */
+	festate = mysql_get_streaming_scan(conn);
+	if (festate != NULL)
+		mysql_buffer_streaming(festate);
+}
+
+#ifdef MYSQL_FDW_NONBLOCK
+/*
+ * mysql_async_finish: Complete a non-blocking call on the statement of a
+ * scan, waiting for the connection as often as the call asks to.
+ *
+ * The connection is dropped if the wait fails or is interrupted, since it
+ * is left in the middle of the call.
+ */
+static int
+mysql_async_finish(MySQLFdwExecState *festate, int status, int *ret,
+				   int (*cont) (int *ret, MYSQL_STMT *stmt, int status))
+{
+	PG_TRY();
+	{
+		while (status != 0)
+			status = cont(ret, festate->stmt, mysql_async_wait(festate->conn, status));
+	}
+	PG_CATCH();
+	{
+		mysql_rel_connection(festate->conn);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	if (mysql_get_pending_scan(festate->conn) == festate)
+		mysql_set_pending_scan(festate->conn, NULL);
+
+	return *ret;
+}
+
+/*
+ * mysql_async_wait: Wait until the connection is ready for what a
+ * non-blocking call is waiting for, and return what it is ready for.
+ *
+ * The wait is on the process latch too, so that a cancel or terminate
+ * request is served as soon as it comes, as postgres_fdw does.
+ */
+static int
+mysql_async_wait(MYSQL *conn, int status)
+{
+	pgsocket   sock = _mysql_get_socket(conn);
+#ifdef WL_EXIT_ON_PM_DEATH
+	int        events = WL_LATCH_SET | WL_EXIT_ON_PM_DEATH;
+#else
+	int        events = WL_LATCH_SET | WL_POSTMASTER_DEATH;
+#endif
+	long       timeout = -1;
+	instr_time start;
+
+	if (status & (MYSQL_WAIT_READ | MYSQL_WAIT_EXCEPT))
+		events |= WL_SOCKET_READABLE;
+	if (status & MYSQL_WAIT_WRITE)
+		events |= WL_SOCKET_WRITEABLE;
+	if (status & MYSQL_WAIT_TIMEOUT)
+	{
+		events |= WL_TIMEOUT;
+		timeout = _mysql_get_timeout_value(conn) * 1000L;
+	}
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (;;)
+	{
+		long wait = timeout;
+		int  rc;
+
+		/* What is left of the timeout after the latch woke us up */
+		if (timeout >= 0)
+		{
+			instr_time elapsed;
+
+			INSTR_TIME_SET_CURRENT(elapsed);
+			INSTR_TIME_SUBTRACT(elapsed, start);
+			wait = timeout - (long) INSTR_TIME_GET_MILLISEC(elapsed);
+			if (wait <= 0)
+				return MYSQL_WAIT_TIMEOUT;
+		}
+
+#if PG_VERSION_NUM >= 100000
+		rc = WaitLatchOrSocket(MyLatch, events, sock, wait, PG_WAIT_EXTENSION);
+#else
+		rc = WaitLatchOrSocket(MyLatch, events, sock, wait);
+#endif
+
+		/* Done by WaitLatchOrSocket itself from PG version 12 */
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		if (rc & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		/* An error on the socket shows as ready, for the library to find it */
+		if (rc & (WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE))
+		{
+			int ready = 0;
+
+			if (rc & WL_SOCKET_READABLE)
+				ready |= (status & MYSQL_WAIT_READ) ? MYSQL_WAIT_READ : MYSQL_WAIT_EXCEPT;
+			if (rc & WL_SOCKET_WRITEABLE)
+				ready |= MYSQL_WAIT_WRITE;
+			return ready;
+		}
+
+		if (rc & WL_TIMEOUT)
+			return MYSQL_WAIT_TIMEOUT;
+	}
+}
+
+/*
+ * mysql_scan_reset_callback: The memory of a scan is going away.  If it
+ * has a fetch in flight, which only happens when the scan is aborted, the
+ * connection is in the middle of a call and cannot be used any more.
+ */
+static void
+mysql_scan_reset_callback(void *arg)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) arg;
+
+	if (mysql_get_pending_scan(festate->conn) == festate)
+		mysql_rel_connection(festate->conn);
+}
+#endif
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * mysqlIsForeignScanParallelSafe: Scans of tables set up for parallel
+ * scans may run in parallel workers, which connect to MySQL on their own.
+ */
+static bool
+mysqlIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte)
+{
+	mysql_opt *options = mysql_get_options(rte->relid);
+
+	return options->parallel_workers > 0;
+}
+
+/*
+ * mysqlEstimateDSMForeignScan: Size of the state shared by the processes
+ * of a parallel scan
+ */
+static Size
+mysqlEstimateDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt)
+{
+	return sizeof(MySQLParallelScan);
+}
+
+/*
+ * mysqlInitializeDSMForeignScan: Set up the shared state of a parallel
+ * scan in the leader, which finds the key range to hand out.
+ */
+static void
+mysqlInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt, void *coordinate)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	MySQLParallelScan *pscan = (MySQLParallelScan *) coordinate;
+
+	SpinLockInit(&pscan->mutex);
+	pscan->nparticipants = pcxt->nworkers + 1;
+	mysql_parallel_bounds(festate, pscan);
+	festate->pscan = pscan;
+}
+
+#if PG_VERSION_NUM >= 100000
+/*
+ * mysqlReInitializeDSMForeignScan: Hand out the key range again for a
+ * rescan.
+ */
+static void
+mysqlReInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt, void *coordinate)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+
+	mysql_parallel_bounds(festate, (MySQLParallelScan *) coordinate);
+}
+#endif
+
+/*
+ * mysqlInitializeWorkerForeignScan: Attach a worker to the shared state of
+ * a parallel scan.
+ */
+static void
+mysqlInitializeWorkerForeignScan(ForeignScanState *node, shm_toc *toc, void *coordinate)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+
+	festate->pscan = (MySQLParallelScan *) coordinate;
+}
+
+/*
+ * mysql_parallel_bounds: Find the smallest and largest key values of the
+ * table and make the whole range available again.
+ */
+static void
+mysql_parallel_bounds(MySQLFdwExecState *festate, MySQLParallelScan *pscan)
+{
+	MYSQL_RES *result;
+	MYSQL_ROW row = NULL;
+	int64     first = 0;
+	int64     last = 0;
+	bool      empty = true;
+
+	mysql_finish_pending_fetch(festate->conn);
+
+	result = mysql_run_query(festate->conn, festate->bounds_query);
+	if (result)
+	{
+		row = _mysql_fetch_row(result);
+
+		/* The bounds are NULL for an empty table */
+		if (row && row[0] && row[1])
+		{
+			first = strtoll(row[0], NULL, 10);
+			last = strtoll(row[1], NULL, 10);
+			empty = false;
+		}
+		_mysql_free_result(result);
+	}
+
+	SpinLockAcquire(&pscan->mutex);
+	pscan->first = first;
+	pscan->last = last;
+	pscan->next = first;
+	pscan->min_chunk = Max(((uint64) last - (uint64) first) / MYSQL_PARALLEL_CHUNKS, 1);
+	pscan->exhausted = empty;
+	SpinLockRelease(&pscan->mutex);
+}
+
+/*
+ * mysql_next_range: Claim the next chunk of the key range of a parallel
+ * scan and execute the query for it.  Without workers there is no shared
+ * state, and the one chunk is the whole range.
+ *
+ * Returns false once the range is used up.
+ */
+static bool
+mysql_next_range(MySQLFdwExecState *festate)
+{
+	MySQLParallelScan *pscan = festate->pscan;
+
+	if (pscan == NULL)
+	{
+		if (festate->nchunks > 0)
+			return false;
+
+		festate->range[0] = PG_INT64_MIN;
+		festate->range[1] = PG_INT64_MAX;
+	}
+	else
+	{
+		uint64 remaining;
+		uint64 chunk;
+
+		SpinLockAcquire(&pscan->mutex);
+		if (pscan->exhausted)
+		{
+			SpinLockRelease(&pscan->mutex);
+			return false;
+		}
+
+		remaining = (uint64) pscan->last - (uint64) pscan->next + 1;
+		chunk = remaining / (MYSQL_PARALLEL_SPLIT * pscan->nparticipants);
+		chunk = Max(chunk, (uint64) pscan->min_chunk);
+
+		festate->range[0] = pscan->next;
+		if (chunk >= remaining)
+		{
+			festate->range[1] = pscan->last;
+			pscan->exhausted = true;
+		}
+		else
+		{
+			festate->range[1] = pscan->next + (int64) (chunk - 1);
+			pscan->next = festate->range[1] + 1;
+		}
+		SpinLockRelease(&pscan->mutex);
+	}
+	festate->nchunks++;
+
+	/* Start on the rows of the chunk */
+	festate->batch.nrows = 0;
+	festate->batch.next = 0;
+	festate->batch.done = false;
+	festate->fetch_pending = false;
+	festate->fetch_left = festate->fetch_size;
+
+	if (mysql_execute_scan(festate) != 0)
+		mysql_stmt_error_report(festate, "failed to execute the MySQL query");
+
+	return true;
+}
+#endif
+
+#if PG_VERSION_NUM >= 140000
+/*
+ * mysqlIsForeignPathAsyncCapable: Tell whether the scan can run
+ * asynchronously under an Append.
+ */
+static bool
+mysqlIsForeignPathAsyncCapable(ForeignPath *path)
+{
+	RelOptInfo           *baserel = ((Path *) path)->parent;
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) baserel->fdw_private;
+
+	/* The processes of a parallel scan share nothing an Append could wait on */
+	if (((Path *) path)->parallel_aware)
+		return false;
+
+	return fpinfo->async_capable;
+}
+
+/*
+ * mysqlForeignAsyncRequest: Produce the next row of the scan for the
+ * Append, or leave the request pending if it has still to come from MySQL.
+ */
+static void
+mysqlForeignAsyncRequest(AsyncRequest *areq)
+{
+	mysql_produce_tuple_async(areq);
+}
+
+/*
+ * mysqlForeignAsyncConfigureWait: Have the Append wait on the socket of the
+ * connection for the fetch in flight.
+ */
+static void
+mysqlForeignAsyncConfigureWait(AsyncRequest *areq)
+{
+	ForeignScanState  *node = (ForeignScanState *) areq->requestee;
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+#ifdef MYSQL_FDW_NONBLOCK
+	AppendState       *requestor = (AppendState *) areq->requestor;
+	uint32            events = 0;
+#endif
+
+	Assert(areq->callback_pending);
+
+#ifdef MYSQL_FDW_NONBLOCK
+	/*
+	 * A fetch waiting for a timeout only has nothing for the event set to
+	 * wait on.  Complete it here, the library tells the timeout apart.
+	 */
+	if (festate->async_status != 0 &&
+		(festate->async_status & (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE)) == 0)
+	{
+		mysql_async_finish(festate, festate->async_status, &festate->async_ret,
+						   _mysql_stmt_fetch_cont);
+		festate->async_status = 0;
+	}
+#endif
+
+	/*
+	 * The fetch may have been completed meanwhile, so that another scan of
+	 * the server could use the connection.  The row is there already.
+	 */
+	if (festate->async_status == 0)
+	{
+		areq->callback_pending = false;
+		mysql_produce_tuple_async(areq);
+		ExecAsyncResponse(areq);
+		if (!areq->callback_pending)
+			return;
+	}
+
+#ifdef MYSQL_FDW_NONBLOCK
+	if (festate->async_status & MYSQL_WAIT_READ)
+		events |= WL_SOCKET_READABLE;
+	if (festate->async_status & MYSQL_WAIT_WRITE)
+		events |= WL_SOCKET_WRITEABLE;
+
+	AddWaitEventToSet(requestor->as_eventset, events, _mysql_get_socket(festate->conn),
+					  NULL, areq);
+#endif
+}
+
+/*
+ * mysqlForeignAsyncNotify: The socket of the connection is ready; move the
+ * fetch on and produce the row if it has arrived.
+ */
+static void
+mysqlForeignAsyncNotify(AsyncRequest *areq)
+{
+#ifdef MYSQL_FDW_NONBLOCK
+	ForeignScanState  *node = (ForeignScanState *) areq->requestee;
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+
+	/* The socket is all that was waited for, see mysqlForeignAsyncConfigureWait */
+	if (festate->fetch_pending && festate->async_status != 0)
+	{
+		festate->async_status = _mysql_stmt_fetch_cont(&festate->async_ret, festate->stmt,
+													   festate->async_status &
+													   (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE));
+		if (festate->async_status == 0)
+			mysql_set_pending_scan(festate->conn, NULL);
+	}
+#endif
+
+	mysql_produce_tuple_async(areq);
+}
+
+/*
+ * mysql_produce_tuple_async: Complete an asynchronous request with the next
+ * row that passes the local conditions, or with NULL at the end of the
+ * scan.  The request stays pending while MySQL has yet to send the row.
+ */
+static void
+mysql_produce_tuple_async(AsyncRequest *areq)
+{
+	ForeignScanState  *node = (ForeignScanState *) areq->requestee;
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	TupleTableSlot    *result;
+
+	result = ExecProcNode((PlanState *) node);
+	if (TupIsNull(result) && festate->async_mode && !festate->batch.done)
+		ExecAsyncRequestPending(areq);
+	else
+		ExecAsyncRequestDone(areq, result);
+}
+#endif
+
+
+/*
+ * mysqlExplainForeignScan: Produce extra output for EXPLAIN
+ */
+static void
+mysqlExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+	mysql_opt *options = festate->mysqlFdwOptions;
+
+	/* Give the figures the costs were derived from */
+	if (es->verbose)
+	{
+		int width = node->ss.ps.plan->plan_width;
+
+		mysql_explain_property_float("Remote startup cost", NULL,
+									 options->fdw_startup_cost + options->rtt_ms * MYSQL_MS_COST,
+									 2, es);
+		mysql_explain_property_float("Remote row cost", NULL,
+									 options->fdw_tuple_cost + width * options->fdw_byte_cost,
+									 4, es);
+		mysql_explain_property_float("Round trip", "ms", options->rtt_ms, 3, es);
+		ExplainPropertyText("Remote query", festate->query, es);
+		if (festate->remote_access[0] != '\0')
+			ExplainPropertyText("Remote access", festate->remote_access, es);
+		ExplainPropertyText("Fetch mode", mysql_fetch_mode_name(festate->fetch_mode), es);
+		mysql_explain_property_int("Batch size", "rows", festate->batch.size, es);
+		if (festate->lookup_batch > 0)
+			mysql_explain_property_int("Lookup batch size", "keys", festate->lookup_batch, es);
+
+		/* The fetch size only matters to cursors */
+		if (festate->fetch_mode == MYSQL_FETCH_CURSOR)
+		{
+			if (festate->fetch_adaptive)
+				ExplainPropertyText("Fetch size",
+									psprintf("auto, %d to %lu rows", MYSQL_FETCH_MIN, festate->fetch_max),
+									es);
+			else
+				mysql_explain_property_int("Fetch size", "rows", festate->fetch_size, es);
+		}
+	}
+
+	/*
+	 * Show how much catalog work the scan needed to convert its rows, and
+	 * how many values still had to be parsed by an input function.
+	 */
+	if (es->analyze)
+	{
+		long		ncalls = 0;
+		int			i;
+
+		mysql_explain_property_int("Type Lookups", NULL, festate->type_lookups, es);
+		if (festate->table)
+			for (i = 0; i < festate->table->ncolumns; i++)
+				ncalls += festate->table->converter[i].ncalls;
+		mysql_explain_property_int("Input Function Calls", NULL, ncalls, es);
+	}
+
+	/*
+	 * And the most memory it held for them.  Servers before 13 cannot tell
+	 * what a context holds, so only the size of the fetched values is given
+	 * there, under a name that says so.
+	 */
+	if (es->analyze && festate->table)
+	{
+		mysql_track_memory(festate);
+#if PG_VERSION_NUM >= 130000
+		mysql_explain_property_int("Peak Memory", "kB",
+								   (mysql_scan_memory(festate) + festate->mem_peak + 1023) / 1024, es);
+#else
+		mysql_explain_property_int("Peak Batch Data", "kB", (festate->mem_peak + 1023) / 1024, es);
+#endif
+	}
+
+	/* And how many rescans were answered without asking MySQL */
+	if (es->analyze && festate->cache != NULL)
+	{
+		mysql_explain_property_int("Cache Hits", NULL, festate->cache_hits, es);
+		mysql_explain_property_int("Cache Misses", NULL, festate->cache_misses, es);
+		if (festate->lookup_batch > 0)
+			mysql_explain_property_int("Lookup Batches", NULL, festate->lookup_batches, es);
+	}
+}
+
+/*
+ * mysql_track_memory: Record the memory taken by the rows of the current
+ * batch, before it is released.
+ *
+ * Servers before 13 cannot tell how much a context holds, the size of
+ * the fetched values is recorded there instead.
+ */
+static void
+mysql_track_memory(MySQLFdwExecState *festate)
+{
+#if PG_VERSION_NUM >= 130000
+	Size used = MemoryContextMemAllocated(festate->temp_cxt, true);
+#else
+	Size used = festate->batch_bytes;
+#endif
+
+	festate->mem_peak = Max(festate->mem_peak, used);
+}
+
+#if PG_VERSION_NUM >= 130000
+/*
+ * mysql_scan_memory: Memory the scan holds for its whole duration, the
+ * bind buffers, which only ever grow, and the batch staging area.
+ */
+static Size
+mysql_scan_memory(MySQLFdwExecState *festate)
+{
+	mysql_table *table = festate->table;
+	Size        total;
+	int         i;
+
+	total = (Size) table->ncolumns * festate->batch.size * (sizeof(Datum) + sizeof(bool));
+	for (i = 0; i < table->ncolumns; i++)
+		total += table->_mysql_bind[i].buffer_length;
+
+	return total;
+}
+#endif
+
+/*
+ * mysql_explain_property_int: Emit an integer EXPLAIN property on any
+ * supported server version.
+ */
+static void
+mysql_explain_property_int(const char *qlabel, const char *unit, int64 value, ExplainState *es)
+{
+#if PG_VERSION_NUM >= 110000
+	ExplainPropertyInteger(qlabel, unit, value, es);
+#else
+	ExplainPropertyLong(qlabel, (long) value, es);
+#endif
+}
+
+/*
+ * mysql_explain_property_float: Emit a floating point EXPLAIN property on
+ * any supported server version.
+ */
+static void
+mysql_explain_property_float(const char *qlabel, const char *unit, double value, int ndigits,
+							 ExplainState *es)
+{
+#if PG_VERSION_NUM >= 110000
+	ExplainPropertyFloat(qlabel, unit, value, ndigits, es);
+#else
+	ExplainPropertyFloat(qlabel, value, ndigits, es);
+#endif
+}
+
+/*
+ * mysqlEndForeignScan: Finish scanning foreign table and dispose
+ * objects used for this scan
+ */
+static void
+mysqlEndForeignScan(ForeignScanState *node)
+{
+	MySQLFdwExecState *festate = (MySQLFdwExecState *) node->fdw_state;
+
+    if (festate->table)
+    {
+         if (festate->table->_mysql_res) {
+               _mysql_free_result(festate->table->_mysql_res);
+               festate->table->_mysql_res = NULL;
+         }
+       }
+
+	/* Closing the statement needs the connection */
+	mysql_end_streaming(festate);
+	mysql_finish_pending_fetch(festate->conn);
+
+	if (festate->stmt)
+	{
+		_mysql_stmt_close(festate->stmt);
+		festate->stmt = NULL;
+	}
+
+	if (festate->store)
+	{
+		tuplestore_end(festate->store);
+		festate->store = NULL;
+	}
+
+	if (festate->store_slot)
+	{
+		ExecDropSingleTupleTableSlot(festate->store_slot);
+		festate->store_slot = NULL;
+	}
+
+	if (festate->cache_slot)
+	{
+		ExecDropSingleTupleTableSlot(festate->cache_slot);
+		festate->cache_slot = NULL;
+	}
+}
+
+/*
+ * mysqlReScanForeignScan: Rescan table, possibly with new parameters
+ */
+static void
+mysqlReScanForeignScan(ForeignScanState *node)
+{
+        MySQLFdwExecState  *festate = (MySQLFdwExecState *) node->fdw_state;
+
+	/*
+	 * Drop what is left of the previous result.  The statement stays
+	 * prepared; the parameters may not have their new values yet, they are
+	 * bound when the first row is asked for.
+	 */
+	if (festate->scan_started && !festate->batch.done)
+		mysql_reset_scan(festate);
+	festate->scan_started = false;
+	festate->params_bound = false;
+}
+
+/*
+ * mysql_bind_scan: Bind the parameters of a scan as the first row is asked
+ * for, and set the scan up to read its rows for them: from the rows kept of
+ * an earlier scan, or by running the query again.
+ */
+static void
+mysql_bind_scan(ForeignScanState *node)
+{
+	MySQLFdwExecState  *festate = (MySQLFdwExecState *) node->fdw_state;
+	bool		changed;
+
+	festate->scan_started = true;
+
+	/* Rebind the parameters whose value changed */
+	changed = bind_query_params(node);
+	festate->params_bound = true;
+
+	/*
+	 * Answer the scan with the rows of an earlier one with these values,
+	 * or with those of a lookup of several keys.
+	 */
+	if (mysql_cache_lookup(node) ||
+		(festate->lookup_batch > 0 && mysql_lookup_batch(node)))
+	{
+		/* The store no longer holds the rows of the bound parameters */
+		if (festate->store != NULL)
+		{
+			tuplestore_clear(festate->store);
+			festate->store_filled = false;
+			festate->store_partial = false;
+		}
+		festate->batch.nrows = 0;
+		festate->batch.next = 0;
+		festate->batch.done = true;
+		return;
+	}
+
+	if (festate->fetch_mode == MYSQL_FETCH_BUFFERED)
+	{
+		/* With the same parameters the result stays the same, read it again locally */
+		if (festate->store_filled && !festate->store_partial && !changed)
+		{
+			tuplestore_rescan(festate->store);
+			return;
+		}
+		tuplestore_clear(festate->store);
+		festate->store_filled = false;
+		festate->store_partial = false;
+	}
+
+	/* A parallel scan starts over on the chunks handed out from now on */
+	if (festate->parallel)
+	{
+		festate->batch.nrows = 0;
+		festate->batch.next = 0;
+		festate->batch.done = true;
+		festate->nchunks = 0;
+		return;
+	}
+
+	/* Start the new scan with a small batch again */
+	if (festate->fetch_adaptive)
+	{
+		festate->fetch_size = MYSQL_FETCH_MIN;
+		_mysql_stmt_attr_set(festate->stmt, STMT_ATTR_PREFETCH_ROWS,
+							 (void*) &festate->fetch_size);
+	}
+	festate->fetch_left = festate->fetch_size;
+
+	/* Forget the rows of the previous scan */
+	festate->batch.nrows = 0;
+	festate->batch.next = 0;
+	festate->batch.done = false;
+	festate->fetch_pending = false;
+
+	/* The query runs now */
+	festate->scan_started = false;
+}
+
+/*
+ * mysqlGetForeignRelSize: Create a FdwPlan for a scan on the foreign table
+ */
+static void
+mysqlGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
+{
+	StringInfoData       sql;
+	double               rows = 0;
+	Bitmapset            *attrs_used = NULL;
+	List                 *retrieved_attrs = NULL;
+	mysql_opt            *options = NULL;
+	Oid                  userid =  GetUserId();
+	ForeignServer        *server;
+	UserMapping          *user;
+	ForeignTable         *table;
+	MySQLFdwRelationInfo *fpinfo;
+	MySQLTableMeta       *meta;
+	ListCell             *lc;
+	List                *params_list = NULL;
+
+	fpinfo = (MySQLFdwRelationInfo *) palloc0(sizeof(MySQLFdwRelationInfo));
+	baserel->fdw_private = (void *) fpinfo;
+
+	table = GetForeignTable(foreigntableid);
+	server = GetForeignServer(table->serverid);
+	user = GetUserMapping(userid, server->serverid);
+
+	/* Fetch options */
+	options = mysql_get_options(foreigntableid);
+
+	/* Joins with other tables of the same server may be sent to MySQL */
+	fpinfo->pushdown_safe = true;
+	fpinfo->options = options;
+	fpinfo->server = server;
+	fpinfo->user = user;
+
+	/* MySQL is only asked what is not known from earlier plans */
+	meta = mysql_table_meta(foreigntableid);
+
+#ifdef MYSQL_FDW_NONBLOCK
+	/* Asynchronous scans need the non-blocking client API */
+	fpinfo->async_capable = options->async_capable && _mysql_stmt_fetch_start != NULL;
+#endif
+
+	/* A parallel scan splits the table on an integer primary key */
+	if (options->parallel_workers > 0)
+	{
+		if (meta == NULL)
+			fpinfo->parallel_key = mysql_find_parallel_key(mysql_plan_connection(fpinfo), options);
+		else
+		{
+			if (!meta->key_known)
+			{
+				char *key = mysql_find_parallel_key(mysql_plan_connection(fpinfo), options);
+
+				strlcpy(meta->parallel_key, key ? key : "", NAMEDATALEN);
+				meta->key_known = true;
+			}
+			if (meta->parallel_key[0] != '\0')
+				fpinfo->parallel_key = pstrdup(meta->parallel_key);
+		}
+		fpinfo->parallel_workers = options->parallel_workers;
+	}
+
+#if PG_VERSION_NUM >= 90600
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid, &attrs_used);
+#else
+	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &attrs_used);
+#endif
+
+	foreach(lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+
+		if (mysql_is_foreign_expr(root, baserel, ri->clause))
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, ri);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, ri);
+	}
+
+#if PG_VERSION_NUM >= 90600
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid, &fpinfo->attrs_used);
+#else
+	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &fpinfo->attrs_used);
+#endif
+	foreach(lc, fpinfo->local_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		pull_varattnos((Node *) rinfo->clause, baserel->relid, &fpinfo->attrs_used);
+	}
+
+	if (options->use_remote_estimate)
+	{
+		initStringInfo(&sql);
+		mysql_deparse_select(&sql, root, baserel, fpinfo->attrs_used, options->svr_table, 
+							 &retrieved_attrs, NULL);
+		if (fpinfo->remote_conds)
+			mysql_append_where_clause(&sql, root, baserel, fpinfo->remote_conds,
+						  true, &params_list);
+
+		if (!mysql_estimate_lookup(server->serverid, sql.data, &fpinfo->remote))
+		{
+			mysql_explain_query(mysql_plan_connection(fpinfo), sql.data, &fpinfo->remote);
+			mysql_estimate_store(server->serverid, sql.data, &fpinfo->remote);
+		}
+		rows = fpinfo->remote.rows;
+
+		/* Sorting on, or looking up, the leading column of an index is cheap for MySQL */
+		if (meta == NULL)
+			fpinfo->index_columns = mysql_find_index_columns(mysql_plan_connection(fpinfo), options);
+		else
+		{
+			if (!meta->indexes_known)
+			{
+				List          *columns = mysql_find_index_columns(mysql_plan_connection(fpinfo), options);
+				MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+				meta->index_columns = mysql_copy_index_columns(columns);
+				meta->indexes_known = true;
+				MemoryContextSwitchTo(oldcontext);
+			}
+			fpinfo->index_columns = mysql_copy_index_columns(meta->index_columns);
+		}
+	}
+	if (rows <= 0)
+		rows  = DEFAULTE_NUM_ROWS;
+
+	baserel->rows = rows;
+	baserel->tuples = rows;
+}
+
+
+static bool
+mysql_is_column_unique(Oid foreigntableid)
+{
+	StringInfoData       sql;
+	MYSQL                *conn = NULL;
+	MYSQL_RES            *result = NULL;
+	MYSQL_ROW            row;
+	mysql_opt            *options = NULL;
+	Oid                  userid =  GetUserId();
+	ForeignServer        *server;
+	UserMapping          *user;
+	ForeignTable         *table;
+
+	table = GetForeignTable(foreigntableid);
+	server = GetForeignServer(table->serverid);
+	user = GetUserMapping(userid, server->serverid);
+
+	/* Fetch the options */
+	options = mysql_get_options(foreigntableid);
+
+	/* Connect to the server */
+	conn = mysql_get_connection(server, user, options, false);
+
+	/* Build the query */
+	initStringInfo(&sql);
+
+	appendStringInfo(&sql, "EXPLAIN %s", options->svr_table);
+	if (_mysql_query(conn, sql.data) != 0)
+	{
+		switch(_mysql_errno(conn))
+		{
+			case CR_NO_ERROR:
+				break;
+
+			case CR_OUT_OF_MEMORY:
+			case CR_SERVER_GONE_ERROR:
+			case CR_SERVER_LOST:
+			case CR_UNKNOWN_ERROR:
+			{
+				char *err = pstrdup(_mysql_error(conn));
+				mysql_rel_connection(conn);
+				ereport(ERROR,
+							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+							errmsg("failed to execute the MySQL query: \n%s", err)));
+			}
+			break;
+			case CR_COMMANDS_OUT_OF_SYNC:
+			default:
+			{
+				char *err = pstrdup(_mysql_error(conn));
+				ereport(ERROR,
+							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+							errmsg("failed to execute the MySQL query: \n%s", err)));
+			}
+		}
+	}
+
+	result = _mysql_store_result(conn);
+	if (result)
+	{
+		int num_fields = _mysql_num_fields(result);
+		row = _mysql_fetch_row(result);
+		if (row && num_fields > 3)
+		{
+			if ((strcmp(row[3], "PRI") == 0) || (strcmp(row[3], "UNI")) == 0)
+			{
+				_mysql_free_result(result);
+				return true;
+			}
+		}
+		_mysql_free_result(result);
+	}
+	return false;
+}
+
+/*
+ * mysql_find_parallel_key: Find the column a parallel scan of the table
+ * can split its work on.  It must be the whole primary key and have an
+ * integer type whose values fit in an int64.
+ *
+ * Returns NULL if the table has no such column.
+ */
+static char *
+mysql_find_parallel_key(MYSQL *conn, mysql_opt *options)
+{
+	StringInfoData sql;
+	MYSQL_RES      *result;
+	MYSQL_ROW      row;
+	char           *key = NULL;
+
+	if (options->svr_database == NULL)
+		return NULL;
+
+	initStringInfo(&sql);
+	mysql_deparse_primary_key(&sql, options->svr_database, options->svr_table);
+
+	result = mysql_run_query(conn, sql.data);
+	if (result == NULL)
+		return NULL;
+
+	/* A composite key has one row per column */
+	if (_mysql_num_rows(result) == 1 && (row = _mysql_fetch_row(result)) != NULL)
+	{
+		const char *data_type = row[1];
+
+		if (pg_strcasecmp(data_type, "tinyint") == 0 ||
+			pg_strcasecmp(data_type, "smallint") == 0 ||
+			pg_strcasecmp(data_type, "mediumint") == 0 ||
+			pg_strcasecmp(data_type, "int") == 0 ||
+			(pg_strcasecmp(data_type, "bigint") == 0 && strstr(row[2], "unsigned") == NULL))
+			key = pstrdup(row[0]);
+	}
+	_mysql_free_result(result);
+
+	return key;
+}
+
+/*
+ * mysql_find_index_columns: Find the columns leading an index of the
+ * table, as a list of MySQLIndexColumn.
+ */
+static List *
+mysql_find_index_columns(MYSQL *conn, mysql_opt *options)
+{
+	StringInfoData sql;
+	MYSQL_RES      *result;
+	MYSQL_ROW      row;
+	List           *columns = NIL;
+
+	if (options->svr_database == NULL)
+		return NIL;
+
+	initStringInfo(&sql);
+	mysql_deparse_index_columns(&sql, options->svr_database, options->svr_table);
+
+	result = mysql_run_query(conn, sql.data);
+	if (result == NULL)
+		return NIL;
+
+	while ((row = _mysql_fetch_row(result)) != NULL)
+	{
+		MySQLIndexColumn *column = palloc(sizeof(MySQLIndexColumn));
+
+		column->name = pstrdup(row[0]);
+		column->ndistinct = row[1] ? atof(row[1]) : 0;
+		columns = lappend(columns, column);
+	}
+	_mysql_free_result(result);
+
+	return columns;
+}
+
+/*
+ * mysql_copy_index_columns: Copy of a list of MySQLIndexColumn, in the
+ * current memory context.
+ */
+static List *
+mysql_copy_index_columns(List *columns)
+{
+	List     *copy = NIL;
+	ListCell *lc;
+
+	foreach(lc, columns)
+	{
+		MySQLIndexColumn *column = palloc(sizeof(MySQLIndexColumn));
+
+		*column = *(MySQLIndexColumn *) lfirst(lc);
+		column->name = pstrdup(column->name);
+		copy = lappend(copy, column);
+	}
+
+	return copy;
+}
+
+/*
+ * mysql_plan_connection: The connection planning a relation asks MySQL on,
+ * set up the first time it is needed, so that a plan whose estimates are
+ * all cached does not talk to MySQL at all.
+ */
+static MYSQL *
+mysql_plan_connection(MySQLFdwRelationInfo *fpinfo)
+{
+	if (fpinfo->conn == NULL)
+	{
+		fpinfo->conn = mysql_get_connection(fpinfo->server, fpinfo->user, fpinfo->options, false);
+		_mysql_query(fpinfo->conn, "SET sql_mode='ANSI_QUOTES'");
+	}
+
+	return fpinfo->conn;
+}
+
+/*
+ * mysql_table_meta: The metadata of a foreign table kept from an earlier
+ * planning, made empty if there is none or it is older than
+ * mysql_fdw.estimate_cache_ttl.
+ *
+ * Returns NULL if metadata is not kept.
+ */
+static MySQLTableMeta *
+mysql_table_meta(Oid relid)
+{
+	MySQLTableMeta *meta;
+	bool           found;
+
+	if (estimate_cache_ttl <= 0)
+		return NULL;
+
+	if (table_meta_htab == NULL)
+	{
+		static bool registered = false;
+		HASHCTL     ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(MySQLTableMeta);
+		ctl.hcxt = TopMemoryContext;
+		table_meta_htab = hash_create("mysql_fdw table metadata", 64, &ctl,
+									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		/* The options say which table the metadata is of */
+		if (!registered)
+		{
+			CacheRegisterSyscacheCallback(FOREIGNTABLEREL, mysql_table_meta_invalidate, (Datum) 0);
+			CacheRegisterSyscacheCallback(FOREIGNSERVEROID, mysql_table_meta_invalidate, (Datum) 0);
+			registered = true;
+		}
+	}
+
+	meta = (MySQLTableMeta *) hash_search(table_meta_htab, &relid, HASH_ENTER, &found);
+	if (!found)
+		meta->index_columns = NIL;
+	if (!found ||
+		TimestampDifferenceExceeds(meta->stored, GetCurrentTimestamp(),
+								   estimate_cache_ttl * 1000))
+		mysql_table_meta_reset(meta);
+
+	return meta;
+}
+
+/*
+ * mysql_table_meta_reset: Forget what is known of a foreign table.
+ */
+static void
+mysql_table_meta_reset(MySQLTableMeta *meta)
+{
+	ListCell *lc;
+
+	meta->stored = GetCurrentTimestamp();
+	meta->key_known = false;
+	meta->parallel_key[0] = '\0';
+
+	foreach(lc, meta->index_columns)
+		pfree(((MySQLIndexColumn *) lfirst(lc))->name);
+	list_free_deep(meta->index_columns);
+	meta->index_columns = NIL;
+	meta->indexes_known = false;
+}
+
+/*
+ * mysql_table_meta_invalidate: Forget the metadata of all foreign tables
+ * when the options of one of them, or of a server, may have changed.
+ */
+static void
+mysql_table_meta_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	MySQLTableMeta *meta;
+
+	if (table_meta_htab == NULL)
+		return;
+
+	/*
+	 * Removed entries stay allocated, for a caller still holding one, but
+	 * what they point to does not: callers copy the index columns.
+	 */
+	hash_seq_init(&status, table_meta_htab);
+	while ((meta = (MySQLTableMeta *) hash_seq_search(&status)) != NULL)
+	{
+		mysql_table_meta_reset(meta);
+		hash_search(table_meta_htab, &meta->relid, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * mysql_run_query: Run a query with a small result on conn, and return the
+ * result, if any.
+ */
+static MYSQL_RES *
+mysql_run_query(MYSQL *conn, const char *query)
+{
+	if (_mysql_query(conn, query) != 0)
+	{
+		switch(_mysql_errno(conn))
+		{
+			case CR_NO_ERROR:
+				break;
+
+			case CR_OUT_OF_MEMORY:
+			case CR_SERVER_GONE_ERROR:
+			case CR_SERVER_LOST:
+			case CR_UNKNOWN_ERROR:
+			{
+				char *err = pstrdup(_mysql_error(conn));
+				mysql_rel_connection(conn);
+				ereport(ERROR,
+							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+							errmsg("failed to execute the MySQL query: \n%s", err)));
+			}
+			break;
+			case CR_COMMANDS_OUT_OF_SYNC:
+			default:
+			{
+				char *err = pstrdup(_mysql_error(conn));
+				ereport(ERROR,
+							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+							errmsg("failed to execute the MySQL query: \n%s", err)));
+			}
+		}
+	}
+	return _mysql_store_result(conn);
+}
+
+/*
+ * mysql_explain_query: Ask MySQL how many rows the given SELECT returns,
+ * what it costs and how it reads its tables.
+ *
+ * EXPLAIN FORMAT=JSON gives all of it; servers that don't know it fall
+ * back to the tabular EXPLAIN, which has no cost.
+ */
+static void
+mysql_explain_query(MYSQL *conn, const char *query, MySQLRemoteEstimate *estimate)
+{
+	MemSet(estimate, 0, sizeof(*estimate));
+
+	if (!mysql_explain_json(conn, query, estimate))
+		mysql_explain_table(conn, query, estimate);
+}
+
+/*
+ * mysql_explain_json: Read the estimate of a query from EXPLAIN
+ * FORMAT=JSON.
+ *
+ * The outermost query block gives the query_cost.  Each table of its join
+ * gives the rows produced by the join up to it, so the last one gives the
+ * rows of the query; servers that don't give rows_produced_per_join have
+ * the product of the rows examined and filtered of each table instead.
+ * Tables of subqueries, nested deeper, are not counted.  A filesort or a
+ * temporary table means the result is complete before its first row is
+ * sent.  Returns false if the server could not explain the query so.
+ *
+ * The text is read as it comes, rather than as jsonb, which would keep
+ * only the last of the values of a repeated key and reorder the keys of
+ * each object.
+ */
+static bool
+mysql_explain_json(MYSQL *conn, const char *query, MySQLRemoteEstimate *estimate)
+{
+	MYSQL_RES        *result;
+	MYSQL_ROW        row;
+	char             *json;
+	JsonLexContext   *lex;
+	JsonSemAction    sem;
+	MySQLExplainJson state;
+
+	if (_mysql_query(conn, psprintf("EXPLAIN FORMAT=JSON %s", query)) != 0)
+		return false;
+
+	result = _mysql_store_result(conn);
+	if (result == NULL)
+		return false;
+
+	row = _mysql_fetch_row(result);
+	if (row == NULL || row[0] == NULL)
+	{
+		_mysql_free_result(result);
+		return false;
+	}
+	json = pstrdup(row[0]);
+	_mysql_free_result(result);
+
+	MemSet(&state, 0, sizeof(state));
+	state.estimate = estimate;
+	state.best_depth = INT_MAX;
+	state.cost_depth = INT_MAX;
+	initStringInfo(&state.parts);
+
+	MemSet(&sem, 0, sizeof(sem));
+	sem.semstate = (void *) &state;
+	sem.object_start = mysql_json_object_start;
+	sem.object_end = mysql_json_object_end;
+	sem.array_start = mysql_json_array_start;
+	sem.array_end = mysql_json_array_end;
+	sem.object_field_start = mysql_json_field_start;
+	sem.scalar = mysql_json_scalar;
+
+#if PG_VERSION_NUM >= 170000
+	lex = makeJsonLexContextCstringLen(NULL, json, strlen(json), GetDatabaseEncoding(), true);
+#elif PG_VERSION_NUM >= 130000
+	lex = makeJsonLexContextCstringLen(json, strlen(json), GetDatabaseEncoding(), true);
+#else
+	lex = makeJsonLexContextCstringLen(json, strlen(json), true);
+#endif
+
+#if PG_VERSION_NUM >= 130000
+	if (pg_parse_json(lex, &sem) != JSON_SUCCESS)
+		return false;
+#else
+	pg_parse_json(lex, &sem);
+#endif
+
+	estimate->rows = state.rows;
+	estimate->cost = (state.query_cost > 0) ? state.query_cost : state.table_cost;
+
+	return true;
+}
+
+/*
+ * mysql_json_object_start: Start reading a table, given by the object of
+ * a "table" key outside of any other table.
+ */
+static MYSQL_JSON_ACTION
+mysql_json_object_start(void *arg)
+{
+	MySQLExplainJson *state = (MySQLExplainJson *) arg;
+
+	state->depth++;
+	if (state->table_depth == 0 && state->key != NULL && strcmp(state->key, "table") == 0)
+	{
+		state->table_depth = state->depth;
+		state->produced = -1;
+		state->examined = 0;
+		state->filtered = 100;
+		state->read_cost = state->eval_cost = 0;
+		state->type = state->used_key = NULL;
+		resetStringInfo(&state->parts);
+	}
+	state->key = NULL;
+
+	MYSQL_JSON_DONE;
+}
+
+/*
+ * mysql_json_object_end: Count the table whose object ends, if it is of
+ * the outermost join.
+ */
+static MYSQL_JSON_ACTION
+mysql_json_object_end(void *arg)
+{
+	MySQLExplainJson *state = (MySQLExplainJson *) arg;
+
+	if (state->depth == state->table_depth)
+	{
+		/* Only the tables of the outermost join count */
+		if (state->depth < state->best_depth)
+		{
+			state->best_depth = state->depth;
+			state->rows = state->table_cost = 0;
+			state->estimate->access[0] = '\0';
+		}
+		if (state->depth == state->best_depth)
+		{
+			if (state->produced >= 0)
+				state->rows = state->produced;
+			else if (state->examined > 0)
+				state->rows = (state->rows > 0 ? state->rows : 1) *
+					((state->examined + 1) * state->filtered) / 100;
+			state->table_cost += state->read_cost + state->eval_cost;
+			mysql_append_access(state->estimate, state->type, state->used_key,
+								state->parts.data);
+		}
+		state->table_depth = 0;
+	}
+	state->depth--;
+
+	MYSQL_JSON_DONE;
+}
+
+/*
+ * mysql_json_array_start: Note where the used_key_parts of the table being
+ * read start.
+ */
+static MYSQL_JSON_ACTION
+mysql_json_array_start(void *arg)
+{
+	MySQLExplainJson *state = (MySQLExplainJson *) arg;
+
+	state->depth++;
+	if (state->table_depth > 0 && state->depth == state->table_depth + 1 &&
+		state->key != NULL && strcmp(state->key, "used_key_parts") == 0)
+		state->parts_depth = state->depth;
+	state->key = NULL;
+
+	MYSQL_JSON_DONE;
+}
+
+/*
+ * mysql_json_array_end: Leave an array.
+ */
+static MYSQL_JSON_ACTION
+mysql_json_array_end(void *arg)
+{
+	MySQLExplainJson *state = (MySQLExplainJson *) arg;
+
+	if (state->depth == state->parts_depth)
+		state->parts_depth = 0;
+	state->depth--;
+
+	MYSQL_JSON_DONE;
+}
+
+/*
+ * mysql_json_field_start: Remember the key of the value coming.
+ */
+static MYSQL_JSON_ACTION
+mysql_json_field_start(void *arg, char *fname, bool isnull)
+{
+	MySQLExplainJson *state = (MySQLExplainJson *) arg;
+
+	state->key = fname;
+
+	MYSQL_JSON_DONE;
+}
+
+/*
+ * mysql_json_scalar: Take the value of a key, or an element of an array,
+ * that tells something of the query or of the table being read.
+ */
+static MYSQL_JSON_ACTION
+mysql_json_scalar(void *arg, char *token, JsonTokenType tokentype)
+{
+	MySQLExplainJson *state = (MySQLExplainJson *) arg;
+	char             *key = state->key;
+
+	state->key = NULL;
+
+	if (key == NULL)
+	{
+		/* An element of an array */
+		if (state->depth == state->parts_depth && tokentype == JSON_TOKEN_STRING)
+		{
+			if (state->parts.len > 0)
+				appendStringInfoString(&state->parts, ", ");
+			appendStringInfoString(&state->parts, token);
+		}
+	}
+	else if (tokentype == JSON_TOKEN_TRUE || tokentype == JSON_TOKEN_FALSE)
+	{
+		if (tokentype == JSON_TOKEN_TRUE && (strcmp(key, "using_filesort") == 0 ||
+											 strcmp(key, "using_temporary_table") == 0))
+			state->estimate->materialized = true;
+	}
+	else if (strcmp(key, "query_cost") == 0)
+	{
+		if (state->depth < state->cost_depth)
+		{
+			state->query_cost = mysql_json_number(token, tokentype);
+			state->cost_depth = state->depth;
+		}
+	}
+	else if (state->table_depth > 0 && state->depth <= state->table_depth + 1)
+	{
+		if (strcmp(key, "access_type") == 0 && tokentype == JSON_TOKEN_STRING)
+			state->type = pstrdup(token);
+		else if (strcmp(key, "key") == 0 && tokentype == JSON_TOKEN_STRING)
+			state->used_key = pstrdup(token);
+		else if (strcmp(key, "rows_produced_per_join") == 0)
+			state->produced = mysql_json_number(token, tokentype);
+		else if (strcmp(key, "rows_examined_per_scan") == 0 ||
+				 strcmp(key, "rows") == 0)
+			state->examined = mysql_json_number(token, tokentype);
+		else if (strcmp(key, "filtered") == 0)
+			state->filtered = mysql_json_number(token, tokentype);
+		else if (strcmp(key, "read_cost") == 0)
+			state->read_cost = mysql_json_number(token, tokentype);
+		else if (strcmp(key, "eval_cost") == 0)
+			state->eval_cost = mysql_json_number(token, tokentype);
+	}
+
+	MYSQL_JSON_DONE;
+}
+
+/*
+ * mysql_explain_table: Read the estimate of a query from the tabular
+ * EXPLAIN.
+ *
+ * It gives one line per table of the query, with the rows it reads and
+ * the percentage of them left by the conditions; their product is the
+ * estimate.  Zero means MySQL had nothing to say.
+ */
+static void
+mysql_explain_table(MYSQL *conn, const char *query, MySQLRemoteEstimate *estimate)
+{
+	MYSQL_RES   *result;
+	MYSQL_ROW   row;
+	MYSQL_FIELD *fields;
+	double      estimate_rows = 0;
+	bool        found = false;
+	int         num_fields;
+	int         i;
+
+	result = mysql_run_query(conn, psprintf("EXPLAIN %s", query));
+	if (result == NULL)
+		return;
+
+	num_fields = _mysql_num_fields(result);
+	fields = _mysql_fetch_fields(result);
+	while ((row = _mysql_fetch_row(result)) != NULL)
+	{
+		double rows = 0;
+		double filtered = 100;
+		char   *type = NULL;
+		char   *key = NULL;
+
+		for (i = 0; i < num_fields; i++)
+		{
+			if (row[i] == NULL)
+				continue;
+			if (strcmp(fields[i].name, "rows") == 0)
+				rows = atof(row[i]);
+			else if (strcmp(fields[i].name, "filtered") == 0)
+				filtered = atof(row[i]);
+			else if (strcmp(fields[i].name, "type") == 0)
+				type = row[i];
+			else if (strcmp(fields[i].name, "key") == 0)
+				key = row[i];
+			else if (strcmp(fields[i].name, "Extra") == 0 &&
+					 (strstr(row[i], "Using filesort") || strstr(row[i], "Using temporary")))
+				estimate->materialized = true;
+		}
+
+		/* Lines without rows, such as for constant tables, don't count */
+		if (rows <= 0)
+			continue;
+
+		if (!found)
+			estimate_rows = 1;
+		estimate_rows *= ((rows + 1) * filtered) / 100;
+		found = true;
+		mysql_append_access(estimate, type, key, NULL);
+	}
+	_mysql_free_result(result);
+
+	estimate->rows = estimate_rows;
+}
+
+/*
+ * mysql_append_access: Add how MySQL reads a table, such as "range on
+ * PRIMARY (id)", to the access of an estimate.
+ */
+static void
+mysql_append_access(MySQLRemoteEstimate *estimate, const char *type,
+					const char *key, const char *parts)
+{
+	StringInfoData buf;
+
+	if (type == NULL)
+		return;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, estimate->access);
+	if (buf.len > 0)
+		appendStringInfoString(&buf, ", ");
+	appendStringInfoString(&buf, type);
+	if (key != NULL)
+		appendStringInfo(&buf, " on %s", key);
+	if (parts != NULL && parts[0] != '\0')
+		appendStringInfo(&buf, " (%s)", parts);
+
+	strlcpy(estimate->access, buf.data, sizeof(estimate->access));
+	pfree(buf.data);
+}
+
+/*
+ * mysql_json_number: The value of a number of EXPLAIN FORMAT=JSON, which
+ * gives costs and percentages as strings.
+ */
+static double
+mysql_json_number(const char *token, JsonTokenType tokentype)
+{
+	if (tokentype == JSON_TOKEN_NUMBER || tokentype == JSON_TOKEN_STRING)
+		return strtod(token, NULL);
+	return 0;
+}
+
+/*
+ * mysql_normalize_query: Put the text of a query in a form that is the
+ * same for queries which differ only by close enough constants.
+ *
+ * Numbers keep two significant digits, string constants their first
+ * MYSQL_ESTIMATE_PREFIX characters.  Quoted identifiers are kept whole.
+ */
+static void
+mysql_normalize_query(const char *query, StringInfo buf)
+{
+	const char *p = query;
+
+	while (*p != '\0')
+	{
+		char c = *p;
+
+		if (c == '\'')
+		{
+			int nchars = 0;
+
+			appendStringInfoChar(buf, c);
+			for (p++; *p != '\0'; p++)
+			{
+				int len = 1;
+
+				/* A doubled quote is part of the string */
+				if (*p == '\'' && p[1] != '\'')
+					break;
+				if ((*p == '\\' || *p == '\'') && p[1] != '\0')
+					len = 2;
+
+				if (nchars++ < MYSQL_ESTIMATE_PREFIX)
+					appendBinaryStringInfo(buf, p, len);
+				p += len - 1;
+			}
+			appendStringInfoChar(buf, '\'');
+			if (*p != '\0')
+				p++;
+		}
+		else if (c == '`' || c == '"')
+		{
+			const char *end = strchr(p + 1, c);
+
+			end = end ? end + 1 : p + strlen(p);
+			appendBinaryStringInfo(buf, p, end - p);
+			p = end;
+		}
+		else if (isdigit((unsigned char) c) &&
+				 (p == query || !(isalnum((unsigned char) p[-1]) || p[-1] == '_' || p[-1] == '$')))
+		{
+			char   *end;
+			double value = strtod(p, &end);
+
+			if (value == 0)
+				appendStringInfoChar(buf, '0');
+			else
+				appendStringInfo(buf, "%.1e", value);
+			p = end;
+		}
+		else
+		{
+			appendStringInfoChar(buf, c);
+			p++;
+		}
+	}
+}
+
+/*
+ * mysql_estimate_cache: The hash table of the row estimates, created in
+ * local memory the first time if it is not in shared memory.
+ *
+ * Returns NULL if there is no cache.
+ */
+static HTAB *
+mysql_estimate_cache(void)
+{
+	HASHCTL ctl;
+
+	if (estimate_htab != NULL || estimate_cache_size <= 0)
+		return estimate_htab;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(MySQLEstimateKey);
+	ctl.entrysize = sizeof(MySQLEstimateEntry);
+	ctl.hcxt = TopMemoryContext;
+	estimate_htab = hash_create("mysql_fdw estimate cache", 64, &ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	return estimate_htab;
+}
+
+/*
+ * mysql_estimate_key: Hash key of the estimate of a query sent to a server.
+ * The normalized query, which the entry must match too, is left in buf.
+ */
+static void
+mysql_estimate_key(Oid serverid, const char *query, MySQLEstimateKey *key, StringInfo buf)
+{
+	initStringInfo(buf);
+	mysql_normalize_query(query, buf);
+
+	MemSet(key, 0, sizeof(*key));
+	key->serverid = serverid;
+	key->len = (uint32) buf->len;
+	key->hash = DatumGetUInt32(hash_any((const unsigned char *) buf->data, buf->len));
+}
+
+/*
+ * mysql_estimate_lookup: Look for the estimate of a query sent to a
+ * server, unless it is older than mysql_fdw.estimate_cache_ttl.
+ *
+ * Returns true if *estimate was set.
+ */
+static bool
+mysql_estimate_lookup(Oid serverid, const char *query, MySQLRemoteEstimate *estimate)
+{
+	HTAB               *htab = mysql_estimate_cache();
+	MySQLEstimateKey   key;
+	MySQLEstimateEntry *entry;
+	StringInfoData     normalized;
+	bool               found = false;
+
+	if (htab == NULL || estimate_cache_ttl <= 0)
+		return false;
+
+	mysql_estimate_key(serverid, query, &key, &normalized);
+	if (normalized.len >= MYSQL_ESTIMATE_QUERY_LEN)
+	{
+		pfree(normalized.data);
+		return false;
+	}
+
+	if (estimate_shared)
+		LWLockAcquire(estimate_shared->lock, LW_SHARED);
+
+	entry = (MySQLEstimateEntry *) hash_search(htab, &key, HASH_FIND, NULL);
+	if (entry != NULL &&
+		memcmp(entry->query, normalized.data, normalized.len) == 0 &&
+		!TimestampDifferenceExceeds(entry->stored, GetCurrentTimestamp(),
+									estimate_cache_ttl * 1000))
+	{
+		*estimate = entry->estimate;
+		found = true;
+	}
+
+	if (estimate_shared)
+		LWLockRelease(estimate_shared->lock);
+
+	pfree(normalized.data);
+	return found;
+}
+
+/*
+ * mysql_estimate_store: Keep the estimate of a query sent to a server.
+ * That of a query with the same hash key is replaced.
+ *
+ * Once the cache is full, the estimates that are too old make room for
+ * it, or else the oldest one.  Queries too long to be compared are not
+ * kept.
+ */
+static void
+mysql_estimate_store(Oid serverid, const char *query, MySQLRemoteEstimate *estimate)
+{
+	HTAB               *htab = mysql_estimate_cache();
+	MySQLEstimateKey   key;
+	MySQLEstimateEntry *entry;
+	StringInfoData     normalized;
+	TimestampTz        now = GetCurrentTimestamp();
+
+	if (htab == NULL || estimate_cache_ttl <= 0)
+		return;
+
+	mysql_estimate_key(serverid, query, &key, &normalized);
+	if (normalized.len >= MYSQL_ESTIMATE_QUERY_LEN)
+	{
+		pfree(normalized.data);
+		return;
+	}
+
+	if (estimate_shared)
+		LWLockAcquire(estimate_shared->lock, LW_EXCLUSIVE);
+
+	if (hash_search(htab, &key, HASH_FIND, NULL) == NULL &&
+		hash_get_num_entries(htab) >= estimate_cache_size)
+	{
+		HASH_SEQ_STATUS    status;
+		MySQLEstimateEntry *oldest = NULL;
+		bool               expired = false;
+
+		hash_seq_init(&status, htab);
+		while ((entry = (MySQLEstimateEntry *) hash_seq_search(&status)) != NULL)
+		{
+			if (TimestampDifferenceExceeds(entry->stored, now, estimate_cache_ttl * 1000))
+			{
+				hash_search(htab, &entry->key, HASH_REMOVE, NULL);
+				expired = true;
+			}
+			else if (oldest == NULL || entry->stored < oldest->stored)
+				oldest = entry;
+		}
+
+		if (!expired && oldest != NULL)
+			hash_search(htab, &oldest->key, HASH_REMOVE, NULL);
+	}
+
+	entry = (MySQLEstimateEntry *) hash_search(htab, &key, HASH_ENTER_NULL, NULL);
+	if (entry != NULL)
+	{
+		entry->estimate = *estimate;
+		entry->stored = now;
+		memcpy(entry->query, normalized.data, normalized.len + 1);
+	}
+
+	if (estimate_shared)
+		LWLockRelease(estimate_shared->lock);
+
+	pfree(normalized.data);
+}
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * mysql_estimate_shmem_size: Shared memory the row estimates take.
+ */
+static Size
+mysql_estimate_shmem_size(void)
+{
+	return add_size(MAXALIGN(sizeof(MySQLEstimateShared)),
+					hash_estimate_size(estimate_cache_size, sizeof(MySQLEstimateEntry)));
+}
+
+/*
+ * mysql_estimate_shmem_request: Ask for the shared memory and the lock of
+ * the row estimates.
+ */
+static void
+mysql_estimate_shmem_request(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(mysql_estimate_shmem_size());
+	RequestNamedLWLockTranche("mysql_fdw", 1);
+}
+
+/*
+ * mysql_estimate_shmem_startup: Attach to the row estimates in shared
+ * memory, setting them up in the first process to get there.
+ */
+static void
+mysql_estimate_shmem_startup(void)
+{
+	HASHCTL ctl;
+	bool    found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	estimate_shared = ShmemInitStruct("mysql_fdw estimates", sizeof(MySQLEstimateShared), &found);
+	if (!found)
+		estimate_shared->lock = &(GetNamedLWLockTranche("mysql_fdw"))->lock;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(MySQLEstimateKey);
+	ctl.entrysize = sizeof(MySQLEstimateEntry);
+	estimate_htab = ShmemInitHash("mysql_fdw estimate cache",
+								  estimate_cache_size, estimate_cache_size,
+								  &ctl, HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+#endif
+
+/*
+ * mysqlEstimateCosts: Estimate the cost of a query of rel sending rows
+ * rows back from MySQL.
+ *
+ * Starting the query costs fdw_startup_cost and a round trip.  Each row
+ * then costs fdw_tuple_cost, fdw_byte_cost for each of its bytes, and its
+ * processing here.  A cursor makes another round trip for each fetch.
+ */
+static void
+mysqlEstimateCosts(RelOptInfo *rel, mysql_opt *options, double rows,
+				   Cost *startup_cost, Cost *run_cost)
+{
+	Cost           rtt_cost = options->rtt_ms * MYSQL_MS_COST;
+	MySQLFetchMode fetch_mode = options->fetch_mode;
+	double         fetches = 0;
+	double         width;
+
+#if PG_VERSION_NUM >= 90600
+	width = rel->reltarget->width;
+#else
+	width = rel->width;
+#endif
+
+	if (fetch_mode == MYSQL_FETCH_AUTO)
+		fetch_mode = mysql_choose_fetch_mode(rel, rows);
+
+	/* An adaptive fetch doubles its size on each round trip */
+	if (fetch_mode == MYSQL_FETCH_CURSOR)
+	{
+		if (fetch_size_override > 0)
+			fetches = floor(rows / fetch_size_override);
+		else if (options->fetch_adaptive)
+			fetches = floor(log2(rows / MYSQL_FETCH_MIN + 1));
+		else
+			fetches = floor(rows / options->fetch_size);
+	}
+
+	*startup_cost = options->fdw_startup_cost + rtt_cost;
+	*run_cost = fetches * rtt_cost +
+		rows * (options->fdw_tuple_cost + width * options->fdw_byte_cost + cpu_tuple_cost);
+}
+
+
+/*
+ * mysql_remote_cost: Add share of the cost MySQL estimated for the query
+ * of a relation, weighted by remote_cost_factor, to its path's costs.
+ *
+ * MySQL's cost units are about the time to read a page, like the
+ * planner's.  A result that MySQL must complete before sending its first
+ * row costs it all at startup.
+ */
+static void
+mysql_remote_cost(mysql_opt *options, MySQLRemoteEstimate *estimate, double share,
+				  Cost *startup_cost, Cost *run_cost)
+{
+	Cost cost = estimate->cost * options->remote_cost_factor * share;
+
+	if (estimate->materialized)
+		*startup_cost += cost;
+	else
+		*run_cost += cost;
+}
+
+/*
+ * mysqlGetForeignPaths: Get the foreign paths
+ */
+static void
+mysqlGetForeignPaths(PlannerInfo *root,RelOptInfo *baserel,Oid foreigntableid)
+{
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) baserel->fdw_private;
+	Cost startup_cost;
+	Cost run_cost;
+	Cost total_cost;
+#if PG_VERSION_NUM >= 90600
+	ListCell *lc;
+#endif
+
+	/* Estimate costs */
+	mysqlEstimateCosts(baserel, fpinfo->options, baserel->rows, &startup_cost, &run_cost);
+	mysql_remote_cost(fpinfo->options, &fpinfo->remote, 1, &startup_cost, &run_cost);
+	total_cost = startup_cost + run_cost;
+
+	/* Create a ForeignPath node and add it as only possible path */
+	add_path(baserel, (Path *)
+			 create_foreignscan_path(root, baserel,
+#if PG_VERSION_NUM >= 90600
+									 NULL,		/* default pathtarget */
+#endif
+									 baserel->rows,
+									 startup_cost,
+									 total_cost,
+									 NIL,	/* no pathkeys */
+									 NULL,	/* no outer rel either */
+#if PG_VERSION_NUM >= 90500
+									 NULL,	/* no extra plan */
+#endif
+									 NULL));	/* no fdw_private data */
+
+#if PG_VERSION_NUM >= 90600
+	/* The same, sorted by MySQL for ORDER BY or a merge join above */
+	foreach(lc, mysql_get_useful_pathkeys(root, baserel))
+	{
+		List *pathkeys = (List *) lfirst(lc);
+		Cost sort_cost = mysql_sort_cost(root, baserel, pathkeys);
+
+		add_path(baserel, (Path *)
+				 create_foreignscan_path(root, baserel,
+										 NULL,		/* default pathtarget */
+										 baserel->rows,
+										 startup_cost + sort_cost,
+										 total_cost + sort_cost,
+										 pathkeys,
+										 NULL,	/* no outer rel either */
+										 NULL,	/* no extra plan */
+										 NIL));	/* no fdw_private data */
+	}
+
+	/*
+	 * Scans restricted by join clauses, the values of the other side being
+	 * sent as parameters.  A nested loop can then look its inner rows up in
+	 * MySQL's indexes instead of reading the whole table.
+	 */
+	foreach(lc, mysql_get_param_infos(root, baserel))
+	{
+		ParamPathInfo *ppi = (ParamPathInfo *) lfirst(lc);
+		double      rows;
+
+		mysql_param_path_estimate(root, baserel, ppi, &rows, &startup_cost, &run_cost);
+
+		add_path(baserel, (Path *)
+				 create_foreignscan_path(root, baserel,
+										 NULL,		/* default pathtarget */
+										 rows,
+										 startup_cost,
+										 startup_cost + run_cost,
+										 NIL,		/* no pathkeys */
+										 ppi->ppi_req_outer,
+										 NULL,	/* no extra plan */
+										 NIL));	/* no fdw_private data */
+	}
+
+	/*
+	 * With a key to split it on, the scan can also be run by several
+	 * processes, each reading chunks of the key range on its own connection.
+	 */
+	if (baserel->consider_parallel && fpinfo->parallel_key != NULL)
+	{
+		ForeignPath *path;
+		double      rows = baserel->rows / (fpinfo->parallel_workers + 1);
+
+		mysqlEstimateCosts(baserel, fpinfo->options, rows, &startup_cost, &run_cost);
+		mysql_remote_cost(fpinfo->options, &fpinfo->remote, 1.0 / (fpinfo->parallel_workers + 1),
+						  &startup_cost, &run_cost);
+		path = create_foreignscan_path(root, baserel,
+									   NULL,	/* default pathtarget */
+									   rows,
+									   startup_cost,
+									   startup_cost + run_cost,
+									   NIL,		/* no pathkeys */
+									   NULL,	/* no outer rel either */
+									   NULL,	/* no extra plan */
+									   NULL);	/* no fdw_private data */
+		path->path.parallel_aware = true;
+		path->path.parallel_workers = fpinfo->parallel_workers;
+		add_partial_path(baserel, (Path *) path);
+	}
+#endif
+}
+
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * State of mysql_ec_member_matches while looking for join clauses that
+ * equivalence classes imply
+ */
+typedef struct mysql_ec_member_arg
+{
+	Expr	   *current;		/* expression of the rel being looked at */
+	List	   *already_used;	/* expressions looked at before */
+} mysql_ec_member_arg;
+
+/*
+ * mysql_get_param_infos: Parameterizations worth a scan of baserel, one for
+ * each set of other relations whose join clauses MySQL can check.
+ */
+static List *
+mysql_get_param_infos(PlannerInfo *root, RelOptInfo *baserel)
+{
+	List       *ppi_list = NIL;
+	List       *clauses = NIL;
+	ListCell   *lc;
+
+	/* Join clauses of the query */
+	foreach(lc, baserel->joininfo)
+		clauses = lappend(clauses, lfirst(lc));
+
+	/* And those implied by equivalence classes, one member at a time */
+	if (baserel->has_eclass_joins)
+	{
+		mysql_ec_member_arg arg;
+
+		arg.already_used = NIL;
+		for (;;)
+		{
+			List *ec_clauses;
+
+			arg.current = NULL;
+			ec_clauses = generate_implied_equalities_for_column(root, baserel,
+																mysql_ec_member_matches,
+																(void *) &arg,
+																baserel->lateral_referencers);
+			if (arg.current == NULL)
+				break;
+
+			clauses = list_concat(clauses, ec_clauses);
+			arg.already_used = lappend(arg.already_used, arg.current);
+		}
+	}
+
+	foreach(lc, clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		Relids      required_outer;
+
+		if (rinfo->pseudoconstant ||
+			!join_clause_is_movable_to(rinfo, baserel) ||
+			!mysql_is_foreign_expr(root, baserel, rinfo->clause))
+			continue;
+
+		required_outer = bms_union(rinfo->clause_relids, baserel->lateral_relids);
+		required_outer = bms_del_member(required_outer, baserel->relid);
+		if (bms_is_empty(required_outer))
+			continue;
+
+		ppi_list = list_append_unique_ptr(ppi_list,
+										  get_baserel_parampathinfo(root, baserel,
+																	required_outer));
+	}
+
+	return ppi_list;
+}
+
+/*
+ * mysql_ec_member_matches: Pick the expressions of baserel whose implied
+ * join clauses are wanted, one at a time, for
+ * generate_implied_equalities_for_column.
+ */
+static bool
+mysql_ec_member_matches(PlannerInfo *root, RelOptInfo *rel, EquivalenceClass *ec,
+						EquivalenceMember *em, void *arg)
+{
+	mysql_ec_member_arg *state = (mysql_ec_member_arg *) arg;
+
+	/* Once an expression was picked, only it matches */
+	if (state->current != NULL)
+		return equal(em->em_expr, state->current);
+
+	if (list_member(state->already_used, em->em_expr))
+		return false;
+
+	state->current = em->em_expr;
+	return true;
+}
+
+/*
+ * mysql_param_path_estimate: Estimate the rows and costs of one scan of
+ * baserel restricted by the join clauses of ppi.
+ *
+ * An equality on the leading column of an index has MySQL look up
+ * rows / ndistinct rows in it, the matching share of what MySQL estimated
+ * the scan of baserel to cost.  Otherwise the planner's estimate of the
+ * rows is used, and MySQL has to read the whole table each time.
+ */
+static void
+mysql_param_path_estimate(PlannerInfo *root, RelOptInfo *baserel, ParamPathInfo *ppi,
+						  double *rows, Cost *startup_cost, Cost *run_cost)
+{
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) baserel->fdw_private;
+	double      ndistinct = 0;
+	ListCell   *lc;
+
+	foreach(lc, ppi->ppi_clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr     *op = (OpExpr *) rinfo->clause;
+		MySQLIndexColumn *column;
+
+		/* A merge-joinable operator is an equality */
+		if (fpinfo->index_columns == NIL || rinfo->mergeopfamilies == NIL ||
+			!IsA(op, OpExpr) || list_length(op->args) != 2)
+			continue;
+
+		column = mysql_find_index_column(root, baserel, (Expr *) linitial(op->args));
+		if (column == NULL)
+			column = mysql_find_index_column(root, baserel, (Expr *) lsecond(op->args));
+
+		if (column != NULL && column->ndistinct > ndistinct)
+			ndistinct = column->ndistinct;
+	}
+
+	if (ndistinct > 0)
+		*rows = clamp_row_est(baserel->rows / ndistinct);
+	else
+		*rows = ppi->ppi_rows;
+
+	mysqlEstimateCosts(baserel, fpinfo->options, *rows, startup_cost, run_cost);
+
+	if (ndistinct > 0)
+		mysql_remote_cost(fpinfo->options, &fpinfo->remote, *rows / Max(baserel->rows, 1),
+						  startup_cost, run_cost);
+	else if (fpinfo->remote.cost > 0)
+		mysql_remote_cost(fpinfo->options, &fpinfo->remote, 1, startup_cost, run_cost);
+	else
+	{
+		/* Without an index, MySQL reads the whole table for each lookup */
+		*run_cost += baserel->rows * cpu_tuple_cost;
+	}
+}
+
+/*
+ * mysqlGetForeignJoinPaths: Add a path sending the join of two relations
+ * of the same MySQL server to it as a single query.
+ */
+static void
+mysqlGetForeignJoinPaths(PlannerInfo *root,
+						 RelOptInfo *joinrel,
+						 RelOptInfo *outerrel,
+						 RelOptInfo *innerrel,
+						 JoinType jointype,
+						 JoinPathExtraData *extra)
+{
+	MySQLFdwRelationInfo *fpinfo;
+	double      rows;
+	Cost        startup_cost;
+	Cost        run_cost;
+	Cost        total_cost;
+	ForeignPath *joinpath;
+	ListCell    *lc;
+
+	/*
+	 * Only the first combination of sides is looked at, the others would
+	 * make the same query.
+	 */
+	if (joinrel->fdw_private)
+		return;
+
+	/*
+	 * Rows locked or modified by the query would have to be checked again
+	 * one by one, which a join done remotely cannot do.
+	 */
+	if (root->parse->commandType != CMD_SELECT || root->rowMarks)
+		return;
+
+	fpinfo = (MySQLFdwRelationInfo *) palloc0(sizeof(MySQLFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	joinrel->fdw_private = fpinfo;
+
+	if (!mysql_foreign_join_ok(root, joinrel, jointype, outerrel, innerrel, extra))
+		return;
+
+	rows = joinrel->rows;
+	if (fpinfo->options->use_remote_estimate)
+	{
+		StringInfoData sql;
+		List           *retrieved_attrs;
+
+		initStringInfo(&sql);
+		mysql_deparse_rel_select(&sql, root, joinrel, mysql_build_tlist(joinrel), NIL,
+								 &retrieved_attrs, NULL);
+
+		if (!mysql_estimate_lookup(fpinfo->server->serverid, sql.data, &fpinfo->remote))
+		{
+			mysql_explain_query(mysql_plan_connection(fpinfo), sql.data, &fpinfo->remote);
+			mysql_estimate_store(fpinfo->server->serverid, sql.data, &fpinfo->remote);
+		}
+		if (fpinfo->remote.rows > 0)
+			rows = fpinfo->remote.rows;
+	}
+
+	mysqlEstimateCosts(joinrel, fpinfo->options, rows, &startup_cost, &run_cost);
+	mysql_remote_cost(fpinfo->options, &fpinfo->remote, 1, &startup_cost, &run_cost);
+	total_cost = startup_cost + run_cost;
+
+#if PG_VERSION_NUM >= 120000
+	joinpath = create_foreign_join_path(root, joinrel,
+										NULL,	/* default pathtarget */
+										rows,
+										startup_cost,
+										total_cost,
+										NIL,	/* no pathkeys */
+										joinrel->lateral_relids,
+										NULL,	/* no epq path */
+										NIL);	/* no fdw_private */
+#else
+	joinpath = create_foreignscan_path(root, joinrel,
+									   NULL,	/* default pathtarget */
+									   rows,
+									   startup_cost,
+									   total_cost,
+									   NIL,		/* no pathkeys */
+									   joinrel->lateral_relids,
+									   NULL,	/* no epq path */
+									   NIL);	/* no fdw_private */
+#endif
+
+	add_path(joinrel, (Path *) joinpath);
+
+	/* The same, sorted by MySQL for ORDER BY or a merge join above */
+	foreach(lc, mysql_get_useful_pathkeys(root, joinrel))
+	{
+		List *pathkeys = (List *) lfirst(lc);
+		Cost sort_cost = mysql_sort_cost(root, joinrel, pathkeys);
+
+#if PG_VERSION_NUM >= 120000
+		joinpath = create_foreign_join_path(root, joinrel,
+											NULL,	/* default pathtarget */
+											rows,
+											startup_cost + sort_cost,
+											total_cost + sort_cost,
+											pathkeys,
+											joinrel->lateral_relids,
+											NULL,	/* no epq path */
+											NIL);	/* no fdw_private */
+#else
+		joinpath = create_foreignscan_path(root, joinrel,
+										   NULL,	/* default pathtarget */
+										   rows,
+										   startup_cost + sort_cost,
+										   total_cost + sort_cost,
+										   pathkeys,
+										   joinrel->lateral_relids,
+										   NULL,	/* no epq path */
+										   NIL);	/* no fdw_private */
+#endif
+		add_path(joinrel, (Path *) joinpath);
+	}
+}
+
+/*
+ * mysql_same_scan_options: Tell whether two foreign tables are read with
+ * the same options, counting those that may be set on a table.
+ *
+ * The scan of a pushed down join takes the options of one of its tables,
+ * so a join of tables read differently, such as one whose max_blob_size
+ * was raised, is left to be done locally.
+ */
+static bool
+mysql_same_scan_options(mysql_opt *a, mysql_opt *b)
+{
+	return a->max_blob_size == b->max_blob_size &&
+		a->fetch_size == b->fetch_size &&
+		a->fetch_adaptive == b->fetch_adaptive &&
+		a->fetch_mode == b->fetch_mode &&
+		a->batch_size == b->batch_size &&
+		a->async_capable == b->async_capable;
+}
+
+/*
+ * mysql_foreign_join_ok: Tell whether the join can be done by MySQL, and
+ * if so fill in the fdw_private of joinrel with what is needed to deparse
+ * it.
+ */
+static bool
+mysql_foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel, JoinType jointype,
+					  RelOptInfo *outerrel, RelOptInfo *innerrel,
+					  JoinPathExtraData *extra)
+{
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) joinrel->fdw_private;
+	MySQLFdwRelationInfo *fpinfo_o = (MySQLFdwRelationInfo *) outerrel->fdw_private;
+	MySQLFdwRelationInfo *fpinfo_i = (MySQLFdwRelationInfo *) innerrel->fdw_private;
+	List       *vars;
+	ListCell   *lc;
+
+	/*
+	 * MySQL has no FULL JOIN, and semi and anti joins have no plain join
+	 * syntax.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT && jointype != JOIN_RIGHT)
+		return false;
+
+	if (fpinfo_o == NULL || !fpinfo_o->pushdown_safe ||
+		fpinfo_i == NULL || !fpinfo_i->pushdown_safe)
+		return false;
+
+	/* Both sides must be read as the same MySQL user */
+	if (fpinfo_o->server->serverid != fpinfo_i->server->serverid ||
+		fpinfo_o->user->umid != fpinfo_i->user->umid)
+		return false;
+
+	/* The scan of the join can only be read with the options of one side */
+	if (!mysql_same_scan_options(fpinfo_o->options, fpinfo_i->options))
+		return false;
+
+	/*
+	 * Conditions checked locally on either side would have to be checked
+	 * before joining, which cannot be done once the join is remote.
+	 */
+	if (fpinfo_o->local_conds != NIL || fpinfo_i->local_conds != NIL)
+		return false;
+
+	/* References to other relations would need a parameterized join */
+	if (!bms_is_empty(joinrel->lateral_relids))
+		return false;
+
+	/*
+	 * Split the conditions of the join.  Those of an outer join belong in
+	 * its ON clause and must all be sent to MySQL; the others filter the
+	 * joined rows and may be checked locally.
+	 */
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		bool          is_remote = mysql_is_foreign_expr(root, joinrel, rinfo->clause);
+
+		if (rinfo->pseudoconstant)
+			return false;
+
+		if (IS_OUTER_JOIN(jointype) && !RINFO_IS_PUSHED_DOWN(rinfo, joinrel->relids))
+		{
+			if (!is_remote)
+				return false;
+			fpinfo->joinclauses = lappend(fpinfo->joinclauses, rinfo);
+		}
+		else if (is_remote)
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+	}
+
+	/*
+	 * The scan returns plain columns only; whole-row references, system
+	 * columns and placeholders are left to a local join.
+	 */
+	vars = pull_var_clause((Node *) joinrel->reltarget->exprs, PVC_INCLUDE_PLACEHOLDERS);
+	foreach(lc, fpinfo->local_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		vars = list_concat(vars, pull_var_clause((Node *) rinfo->clause,
+												 PVC_INCLUDE_PLACEHOLDERS));
+	}
+	foreach(lc, vars)
+	{
+		Var *var = (Var *) lfirst(lc);
+
+		if (!IsA(var, Var) || var->varattno <= 0)
+			return false;
+	}
+
+	/*
+	 * Bring in the conditions of both sides.  Those of the inner side of an
+	 * outer join go in its ON clause, so they don't remove outer rows.
+	 */
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_LEFT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_RIGHT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  list_copy(fpinfo_o->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   list_copy(fpinfo_i->remote_conds));
+			break;
+
+		default:
+			elog(ERROR, "unsupported join type %d", jointype);
+	}
+
+	/*
+	 * An inner join keeps all of its conditions in ON, so that only outer
+	 * joins above it add a WHERE clause.
+	 */
+	if (jointype == JOIN_INNER)
+	{
+		fpinfo->joinclauses = fpinfo->remote_conds;
+		fpinfo->remote_conds = NIL;
+	}
+
+	fpinfo->outerrel = outerrel;
+	fpinfo->innerrel = innerrel;
+	fpinfo->jointype = jointype;
+	fpinfo->options = fpinfo_o->options;
+	fpinfo->server = fpinfo_o->server;
+	fpinfo->user = fpinfo_o->user;
+	fpinfo->pushdown_safe = true;
+
+	return true;
+}
+
+/*
+ * mysqlGetForeignUpperPaths: Add a path sending the aggregation of a
+ * relation read from MySQL to it, as GROUP BY and HAVING clauses, or the
+ * LIMIT and OFFSET of the query.
+ */
+static void
+mysqlGetForeignUpperPaths(PlannerInfo *root, UpperRelationKind stage,
+						  RelOptInfo *input_rel, RelOptInfo *output_rel
+#if PG_VERSION_NUM >= 110000
+						  , void *extra
+#endif
+						  )
+{
+	MySQLFdwRelationInfo *ifpinfo = (MySQLFdwRelationInfo *) input_rel->fdw_private;
 	MySQLFdwRelationInfo *fpinfo;
-	ListCell             *lc;
-	MYSQL_FIELD          *field;
-	int                  i;
-	int                  num_fields;
-	List                *params_list = NULL;
+	PathTarget *grouping_target = root->upper_targets[UPPERREL_GROUP_AGG];
+	List       *having_quals;
+	List       *group_exprs = NIL;
+	double     input_rows = input_rel->rows;
+	double     rows;
+	Cost       startup_cost;
+	Cost       run_cost;
+	Cost       total_cost;
+	ForeignPath *grouppath;
+
+	/* Only the relations MySQL reads itself are looked at, and once */
+	if (output_rel->fdw_private || ifpinfo == NULL || !ifpinfo->pushdown_safe)
+		return;
+
+#if PG_VERSION_NUM >= 120000
+	if (stage == UPPERREL_ORDERED)
+	{
+		mysql_add_ordered_rel(root, input_rel, output_rel);
+		return;
+	}
+	if (stage == UPPERREL_FINAL)
+	{
+		mysql_add_final_path(root, input_rel, output_rel, (FinalPathExtraData *) extra);
+		return;
+	}
+#endif
+
+	if (stage != UPPERREL_GROUP_AGG)
+		return;
+
+#if PG_VERSION_NUM >= 110000
+	/* Partial aggregates of a partitionwise plan have no MySQL form */
+	if (((GroupPathExtraData *) extra)->patype == PARTITIONWISE_AGGREGATE_PARTIAL)
+		return;
+	having_quals = (List *) ((GroupPathExtraData *) extra)->havingQual;
+#else
+	having_quals = (List *) root->parse->havingQual;
+#endif
 
 	fpinfo = (MySQLFdwRelationInfo *) palloc0(sizeof(MySQLFdwRelationInfo));
-	baserel->fdw_private = (void *) fpinfo;
+	fpinfo->pushdown_safe = false;
+	fpinfo->stage = UPPERREL_GROUP_AGG;
+	fpinfo->outerrel = input_rel;
+	output_rel->fdw_private = fpinfo;
 
-	table = GetForeignTable(foreigntableid);
-	server = GetForeignServer(table->serverid);
-	user = GetUserMapping(userid, server->serverid);
+	if (!mysql_foreign_grouping_ok(root, output_rel, having_quals, &group_exprs))
+		return;
 
-	/* Fetch options */
-	options = mysql_get_options(foreigntableid);
+	/* Without GROUP BY there is a single group */
+	if (group_exprs == NIL)
+		rows = 1;
+	else
+#if PG_VERSION_NUM >= 140000
+		rows = estimate_num_groups(root, group_exprs, input_rows, NULL, NULL);
+#else
+		rows = estimate_num_groups(root, group_exprs, input_rows, NULL);
+#endif
 
-	/* Connect to the server */
-	conn = mysql_get_connection(server, user, options);
+	mysqlEstimateCosts(output_rel, fpinfo->options, rows, &startup_cost, &run_cost);
 
-	_mysql_query(conn, "SET sql_mode='ANSI_QUOTES'");
+	/*
+	 * MySQL goes through all the input rows before sending the first group,
+	 * but much faster than they would be sent here one by one, so the path
+	 * wins whenever there are fewer groups than rows.
+	 */
+	startup_cost += input_rows * cpu_operator_cost;
+	total_cost = startup_cost + run_cost;
 
-#if PG_VERSION_NUM >= 90600
-	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid, &attrs_used);
+#if PG_VERSION_NUM >= 120000
+	grouppath = create_foreign_upper_path(root, output_rel,
+										  grouping_target,
+										  rows,
+										  startup_cost,
+										  total_cost,
+										  NIL,	/* no pathkeys */
+										  NULL,	/* no epq path */
+										  NIL);	/* no fdw_private */
 #else
-	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &attrs_used);
+	grouppath = create_foreignscan_path(root, output_rel,
+										grouping_target,
+										rows,
+										startup_cost,
+										total_cost,
+										NIL,	/* no pathkeys */
+										NULL,	/* no required_outer */
+										NULL,	/* no epq path */
+										NIL);	/* no fdw_private */
 #endif
 
-	foreach(lc, baserel->baserestrictinfo)
+	add_path(output_rel, (Path *) grouppath);
+}
+
+/*
+ * mysql_foreign_grouping_ok: Tell whether the grouping can be done by
+ * MySQL, and if so build the target list of the remote query and return
+ * the grouping expressions in *group_exprs.
+ */
+static bool
+mysql_foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel,
+						  List *having_quals, List **group_exprs)
+{
+	Query      *query = root->parse;
+	PathTarget *grouping_target = root->upper_targets[UPPERREL_GROUP_AGG];
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) grouped_rel->fdw_private;
+	MySQLFdwRelationInfo *ofpinfo = (MySQLFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+	List       *tlist = NIL;
+	ListCell   *lc;
+	int        i = 0;
+
+	/* Grouping sets have no plain GROUP BY form */
+	if (query->groupingSets)
+		return false;
+
+	/* Rows filtered locally would have to be gone before grouping */
+	if (ofpinfo->local_conds != NIL)
+		return false;
+
+	/*
+	 * Each grouping expression is sent as it is.  Other expressions are
+	 * sent too if they can be, else the aggregates and columns they are
+	 * computed from.
+	 */
+	foreach(lc, grouping_target->exprs)
 	{
-		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+		Expr  *expr = (Expr *) lfirst(lc);
+		Index sgref = get_pathtarget_sortgroupref(grouping_target, i);
 
-		if (mysql_is_foreign_expr(root, baserel, ri->clause))
-			fpinfo->remote_conds = lappend(fpinfo->remote_conds, ri);
+		i++;
+
+		if (sgref && get_sortgroupref_clause_noerr(sgref, query->groupClause))
+		{
+			TargetEntry *tle;
+
+			/*
+			 * MySQL would take a constant for a column position, and groups
+			 * text by its own collations, merging values that differ here.
+			 */
+			if (IsA(expr, Const) || OidIsValid(exprCollation((Node *) expr)) ||
+				!mysql_is_foreign_expr(root, grouped_rel, expr))
+				return false;
+
+			tle = makeTargetEntry(expr, list_length(tlist) + 1, NULL, false);
+			tle->ressortgroupref = sgref;
+			tlist = lappend(tlist, tle);
+			*group_exprs = lappend(*group_exprs, expr);
+		}
+		else if (mysql_is_foreign_expr(root, grouped_rel, expr))
+			tlist = add_to_flat_tlist(tlist, list_make1(expr));
 		else
-			fpinfo->local_conds = lappend(fpinfo->local_conds, ri);
+		{
+			List     *aggvars;
+			ListCell *l;
+
+			aggvars = pull_var_clause((Node *) expr, PVC_INCLUDE_AGGREGATES);
+			foreach(l, aggvars)
+			{
+				if (!mysql_is_foreign_expr(root, grouped_rel, (Expr *) lfirst(l)))
+					return false;
+			}
+			tlist = add_to_flat_tlist(tlist, aggvars);
+		}
 	}
 
-#if PG_VERSION_NUM >= 90600
-	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid, &fpinfo->attrs_used);
+	/* HAVING conditions MySQL cannot check are checked on its groups */
+	foreach(lc, having_quals)
+	{
+		Expr         *expr = (Expr *) lfirst(lc);
+		RestrictInfo *rinfo;
+
+#if PG_VERSION_NUM >= 140000
+		rinfo = make_simple_restrictinfo(root, expr);
 #else
-	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &fpinfo->attrs_used);
+		rinfo = make_simple_restrictinfo(expr);
 #endif
+
+		if (mysql_is_foreign_expr(root, grouped_rel, expr))
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+	}
+
+	/* The aggregates and columns they need must be fetched */
 	foreach(lc, fpinfo->local_conds)
 	{
 		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
-		pull_varattnos((Node *) rinfo->clause, baserel->relid, &fpinfo->attrs_used);
+		List         *aggvars;
+		ListCell     *l;
+
+		aggvars = pull_var_clause((Node *) rinfo->clause, PVC_INCLUDE_AGGREGATES);
+		foreach(l, aggvars)
+		{
+			if (!mysql_is_foreign_expr(root, grouped_rel, (Expr *) lfirst(l)))
+				return false;
+		}
+		tlist = add_to_flat_tlist(tlist, aggvars);
 	}
 
-	if (options->use_remote_estimate)
+	fpinfo->grouped_tlist = tlist;
+	fpinfo->options = ofpinfo->options;
+	fpinfo->server = ofpinfo->server;
+	fpinfo->user = ofpinfo->user;
+	fpinfo->pushdown_safe = true;
+
+	return true;
+}
+
+#if PG_VERSION_NUM >= 120000
+/*
+ * mysql_add_ordered_rel: Note whether MySQL can sort the rows of the query
+ * for a LIMIT to be applied to them.
+ *
+ * The sorted paths of a scan or join were added along with the others, as
+ * the query pathkeys are those of the ORDER BY then.  No path is added
+ * here, only what the final stage needs to know.
+ */
+static void
+mysql_add_ordered_rel(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo *ordered_rel)
+{
+	MySQLFdwRelationInfo *ifpinfo = (MySQLFdwRelationInfo *) input_rel->fdw_private;
+	MySQLFdwRelationInfo *fpinfo;
+	ListCell   *lc;
+
+	fpinfo = (MySQLFdwRelationInfo *) palloc0(sizeof(MySQLFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	fpinfo->stage = UPPERREL_ORDERED;
+	fpinfo->outerrel = input_rel;
+	ordered_rel->fdw_private = fpinfo;
+
+	/* Groups are never sorted remotely */
+	if (IS_UPPER_REL(input_rel))
+		return;
+
+	foreach(lc, root->sort_pathkeys)
 	{
-		initStringInfo(&sql);
-		appendStringInfo(&sql, "EXPLAIN ");
+		if (!mysql_is_foreign_pathkey(root, input_rel, (PathKey *) lfirst(lc)))
+			return;
+	}
 
-		mysql_deparse_select(&sql, root, baserel, fpinfo->attrs_used, options->svr_table, 
-							 &retrieved_attrs, NULL);
-		if (fpinfo->remote_conds)
-			mysql_append_where_clause(&sql, root, baserel, fpinfo->remote_conds,
-						  true, &params_list);
+	fpinfo->options = ifpinfo->options;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	fpinfo->pushdown_safe = true;
+}
 
-		if (_mysql_query(conn, sql.data) != 0)
-		{
-			switch(_mysql_errno(conn))
-			{
-				case CR_NO_ERROR:
-					break;
+/*
+ * mysql_add_final_path: Add a path sending the LIMIT and OFFSET of the
+ * query to MySQL along with the scan, join or grouping below, and its
+ * ORDER BY if there is one.
+ */
+static void
+mysql_add_final_path(PlannerInfo *root, RelOptInfo *input_rel, RelOptInfo *final_rel,
+					 FinalPathExtraData *extra)
+{
+	Query      *parse = root->parse;
+	MySQLFdwRelationInfo *ifpinfo = (MySQLFdwRelationInfo *) input_rel->fdw_private;
+	MySQLFdwRelationInfo *fpinfo;
+	List       *pathkeys = NIL;
+	List       *tlist;
+	Path       *input_path = NULL;
+	ForeignPath *finalpath;
+	double     rows;
+	double     offset_rows = 0;
+	double     read_rows;
+	Cost       startup_cost;
+	Cost       total_cost;
+	Cost       mysql_run_cost;
+	Cost       input_run_cost;
+	Cost       fetched_run_cost;
+	Cost       sent_run_cost;
+	Cost       unused;
+	ListCell   *lc;
 
-				case CR_OUT_OF_MEMORY:
-				case CR_SERVER_GONE_ERROR:
-				case CR_SERVER_LOST:
-				case CR_UNKNOWN_ERROR:
-				{
-					char *err = pstrdup(_mysql_error(conn));
-					mysql_rel_connection(conn);
-					ereport(ERROR,
-								(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-								errmsg("failed to execute the MySQL query: \n%s", err)));
-				}
-				break;
-				case CR_COMMANDS_OUT_OF_SYNC:
-				default:
-				{
-					char *err = pstrdup(_mysql_error(conn));
-					ereport(ERROR,
-								(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-								errmsg("failed to execute the MySQL query: \n%s", err)));
-				}
-			}
-		}
-		result = _mysql_store_result(conn);
-		if (result)
+	/* A plain ORDER BY was taken care of by the sorted paths */
+	if (!extra->limit_needed)
+		return;
+
+	/*
+	 * Rows to lock, and those of set-returning functions, are counted
+	 * after the scan.
+	 */
+	if (parse->commandType != CMD_SELECT || parse->rowMarks || parse->hasTargetSRFs)
+		return;
+
+#if PG_VERSION_NUM >= 130000
+	/* MySQL has no WITH TIES */
+	if (parse->limitOption == LIMIT_OPTION_WITH_TIES)
+		return;
+#endif
+
+	if (!mysql_is_foreign_limit(parse->limitCount) ||
+		!mysql_is_foreign_limit(parse->limitOffset))
+		return;
+
+	/* Sorted rows are read from the relation below the ordered one */
+	if (parse->sortClause)
+	{
+		if (!IS_UPPER_REL(input_rel) || ifpinfo->stage != UPPERREL_ORDERED)
+			return;
+		input_rel = ifpinfo->outerrel;
+		ifpinfo = (MySQLFdwRelationInfo *) input_rel->fdw_private;
+		pathkeys = root->sort_pathkeys;
+	}
+	else if (IS_UPPER_REL(input_rel) && ifpinfo->stage != UPPERREL_GROUP_AGG)
+		return;
+
+	/* Rows filtered locally must be gone before they are counted */
+	if (ifpinfo->local_conds != NIL)
+		return;
+
+	/* The scan returns plain columns only, as for a join */
+	tlist = mysql_build_tlist(input_rel);
+	if (!IS_UPPER_REL(input_rel))
+	{
+		foreach(lc, tlist)
 		{
-			/*
-			 * MySQL provide numbers of rows per table invole in
-			 * the statment, but we don't have problem with it
-			 * because we are sending separate query per table
-			 * in FDW.
-			 */
-			row = _mysql_fetch_row(result);
-			num_fields = _mysql_num_fields(result);
-			if (row)
-			{
-				for (i = 0; i < num_fields; i++)
-				{
-					field = _mysql_fetch_field(result);
-					if (strcmp(field->name, "rows") == 0)
-					{
-						if (row[i])
-							rows = atof(row[i]);
-					}
-					else if (strcmp(field->name, "filtered") == 0)
-					{
-						if (row[i])
-							filtered = atof(row[i]);
-					}
-				}
-			}
-			_mysql_free_result(result);
+			Var *var = (Var *) ((TargetEntry *) lfirst(lc))->expr;
+
+			if (!IsA(var, Var) || var->varattno <= 0)
+				return;
 		}
 	}
-	if (rows > 0)
-		rows = ((rows + 1) * filtered) / 100;
-	else
-		rows  = DEFAULTE_NUM_ROWS;
 
-	baserel->rows = rows;
-	baserel->tuples = rows;
+	/* Limit the cheapest of our paths giving the rows in the right order */
+	foreach(lc, input_rel->pathlist)
+	{
+		Path *path = (Path *) lfirst(lc);
+
+		if (!IsA(path, ForeignPath) || path->param_info != NULL ||
+			!pathkeys_contained_in(pathkeys, path->pathkeys))
+			continue;
+		if (input_path == NULL || path->total_cost < input_path->total_cost)
+			input_path = path;
+	}
+	if (input_path == NULL)
+		return;
+
+	/* MySQL stops reading once the limit is reached, as a local Limit would */
+	rows = input_path->rows;
+	startup_cost = input_path->startup_cost;
+	total_cost = input_path->total_cost;
+	adjust_limit_rows_costs(&rows, &startup_cost, &total_cost,
+							extra->offset_est, extra->count_est);
+
+	/*
+	 * That is the cost of a local Limit over the same scan, as the planner
+	 * sees it: as if the scan got only the rows the Limit reads.  It really
+	 * also gets those past the LIMIT in the same fetch, or all of them if
+	 * they are not read through a cursor.  MySQL sends only the rows after
+	 * the OFFSET up to the LIMIT, so the others pay no fdw_tuple_cost,
+	 * fdw_byte_cost or round trips; scale the run cost by the share of the
+	 * local Limit's real one left once they are taken out.
+	 */
+	if (extra->offset_est > 0)
+		offset_rows = extra->offset_est;
+	else if (extra->offset_est < 0)
+		offset_rows = clamp_row_est(input_path->rows * 0.10);
+	read_rows = Min(offset_rows + rows, input_path->rows);
+
+	/* What MySQL does for the rows it reads, besides sending them */
+	mysqlEstimateCosts(input_rel, ifpinfo->options, input_path->rows, &unused, &input_run_cost);
+	mysql_run_cost = Max(input_path->total_cost - input_path->startup_cost - input_run_cost, 0) *
+		read_rows / input_path->rows;
+
+	mysqlEstimateCosts(input_rel, ifpinfo->options,
+					   mysql_fetched_rows(input_rel, ifpinfo->options, input_path->rows, read_rows),
+					   &unused, &fetched_run_cost);
+	mysqlEstimateCosts(input_rel, ifpinfo->options, rows, &unused, &sent_run_cost);
+	if (mysql_run_cost + fetched_run_cost > 0)
+		total_cost = startup_cost + (total_cost - startup_cost) *
+			(mysql_run_cost + sent_run_cost) / (mysql_run_cost + fetched_run_cost);
+
+	fpinfo = (MySQLFdwRelationInfo *) palloc0(sizeof(MySQLFdwRelationInfo));
+	fpinfo->stage = UPPERREL_FINAL;
+	fpinfo->outerrel = input_rel;
+	fpinfo->grouped_tlist = tlist;
+	fpinfo->options = ifpinfo->options;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	fpinfo->pushdown_safe = true;
+	final_rel->fdw_private = fpinfo;
+
+	finalpath = create_foreign_upper_path(root, final_rel,
+										  root->upper_targets[UPPERREL_FINAL],
+										  rows,
+										  startup_cost,
+										  total_cost,
+										  pathkeys,
+										  NULL,	/* no epq path */
+										  NIL);	/* no fdw_private */
+
+	add_path(final_rel, (Path *) finalpath);
 }
 
+/*
+ * mysql_fetched_rows: Estimate how many of the rows rows of a query of rel
+ * MySQL has sent by the time the scan has returned needed of them.
+ *
+ * A cursor sends them one fetch at a time, doubling in size if adaptive,
+ * while buffered and streamed results are read to their end.
+ */
+static double
+mysql_fetched_rows(RelOptInfo *rel, mysql_opt *options, double rows, double needed)
+{
+	MySQLFetchMode fetch_mode = options->fetch_mode;
+	double         fetched;
+
+	if (fetch_mode == MYSQL_FETCH_AUTO)
+		fetch_mode = mysql_choose_fetch_mode(rel, rows);
+	if (fetch_mode != MYSQL_FETCH_CURSOR)
+		return rows;
+
+	if (fetch_size_override > 0)
+		fetched = ceil(needed / fetch_size_override) * fetch_size_override;
+	else if (options->fetch_adaptive)
+		fetched = MYSQL_FETCH_MIN * (pow(2, ceil(log2(needed / MYSQL_FETCH_MIN + 1))) - 1);
+	else
+		fetched = ceil(needed / options->fetch_size) * options->fetch_size;
+
+	return Min(fetched, rows);
+}
+#endif
 
-static bool
-mysql_is_column_unique(Oid foreigntableid)
+/*
+ * mysql_build_tlist: Columns a join or grouped scan has to return, those of
+ * its target and those its local conditions need.
+ */
+static List *
+mysql_build_tlist(RelOptInfo *foreignrel)
 {
-	StringInfoData       sql;
-	MYSQL                *conn = NULL;
-	MYSQL_RES            *result = NULL;
-	MYSQL_ROW            row;
-	mysql_opt            *options = NULL;
-	Oid                  userid =  GetUserId();
-	ForeignServer        *server;
-	UserMapping          *user;
-	ForeignTable         *table;
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) foreignrel->fdw_private;
+	List       *tlist;
+	ListCell   *lc;
 
-	table = GetForeignTable(foreigntableid);
-	server = GetForeignServer(table->serverid);
-	user = GetUserMapping(userid, server->serverid);
+	/* That of a grouped relation was made while checking it */
+	if (IS_UPPER_REL(foreignrel))
+		return fpinfo->grouped_tlist;
 
-	/* Fetch the options */
-	options = mysql_get_options(foreigntableid);
+	tlist = add_to_flat_tlist(NIL, pull_var_clause((Node *) foreignrel->reltarget->exprs,
+												   PVC_RECURSE_PLACEHOLDERS));
+	foreach(lc, fpinfo->local_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
 
-	/* Connect to the server */
-	conn = mysql_get_connection(server, user, options);
+		tlist = add_to_flat_tlist(tlist, pull_var_clause((Node *) rinfo->clause,
+														 PVC_RECURSE_PLACEHOLDERS));
+	}
 
-	/* Build the query */
-	initStringInfo(&sql);
+	return tlist;
+}
 
-	appendStringInfo(&sql, "EXPLAIN %s", options->svr_table);
-	if (_mysql_query(conn, sql.data) != 0)
+/*
+ * mysql_get_useful_pathkeys: Orders worth asking MySQL to sort the rows of
+ * rel in, that of the query and those of the merge joins it may be part of.
+ */
+static List *
+mysql_get_useful_pathkeys(PlannerInfo *root, RelOptInfo *rel)
+{
+	List       *useful = NIL;
+	ListCell   *lc;
+
+	if (root->query_pathkeys != NIL)
 	{
-		switch(_mysql_errno(conn))
-		{
-			case CR_NO_ERROR:
-				break;
+		bool ok = true;
 
-			case CR_OUT_OF_MEMORY:
-			case CR_SERVER_GONE_ERROR:
-			case CR_SERVER_LOST:
-			case CR_UNKNOWN_ERROR:
-			{
-				char *err = pstrdup(_mysql_error(conn));
-				mysql_rel_connection(conn);
-				ereport(ERROR,
-							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-							errmsg("failed to execute the MySQL query: \n%s", err)));
-			}
-			break;
-			case CR_COMMANDS_OUT_OF_SYNC:
-			default:
+		foreach(lc, root->query_pathkeys)
+		{
+			if (!mysql_is_foreign_pathkey(root, rel, (PathKey *) lfirst(lc)))
 			{
-				char *err = pstrdup(_mysql_error(conn));
-				ereport(ERROR,
-							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-							errmsg("failed to execute the MySQL query: \n%s", err)));
+				ok = false;
+				break;
 			}
 		}
+		if (ok)
+			useful = lappend(useful, root->query_pathkeys);
 	}
 
-	result = _mysql_store_result(conn);
-	if (result)
+	if (rel->has_eclass_joins)
 	{
-		int num_fields = _mysql_num_fields(result);
-		row = _mysql_fetch_row(result);
-		if (row && num_fields > 3)
+		foreach(lc, root->eq_classes)
 		{
-			if ((strcmp(row[3], "PRI") == 0) || (strcmp(row[3], "UNI")) == 0)
-			{
-				_mysql_free_result(result);
-				return true;
-			}
+			EquivalenceClass *ec = (EquivalenceClass *) lfirst(lc);
+			List       *pathkeys;
+
+			if (!eclass_useful_for_merging(root, ec, rel))
+				continue;
+
+			pathkeys = list_make1(make_canonical_pathkey(root, ec,
+														 linitial_oid(ec->ec_opfamilies),
+														 BTLessStrategyNumber,
+														 false));
+			if (!mysql_is_foreign_pathkey(root, rel, (PathKey *) linitial(pathkeys)))
+				continue;
+
+			/* The query may ask for this order already */
+			if (useful != NIL &&
+				compare_pathkeys(pathkeys, (List *) linitial(useful)) == PATHKEYS_EQUAL)
+				continue;
+
+			useful = lappend(useful, pathkeys);
 		}
-		_mysql_free_result(result);
 	}
-	return false;
+
+	return useful;
+}
+
+/*
+ * mysql_sort_cost: Cost of MySQL sorting the rows of rel.
+ *
+ * Rows read off an index led by the first sort column come in order at
+ * little cost; others are sorted like they would be here.
+ */
+static Cost
+mysql_sort_cost(PlannerInfo *root, RelOptInfo *rel, List *pathkeys)
+{
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) rel->fdw_private;
+	PathKey    *pathkey = (PathKey *) linitial(pathkeys);
+	double     rows = Max(rel->rows, 2.0);
+
+	if (fpinfo->index_columns != NIL &&
+		!mysql_pathkey_null_order_differs(root, rel, pathkey) &&
+		mysql_find_index_column(root, rel, mysql_find_em_expr(pathkey->pk_eclass, rel)) != NULL)
+		return rows * cpu_operator_cost;
+
+	return 2.0 * cpu_operator_cost * rows * (log(rows) / log(2.0));
 }
 
 /*
- * mysqlEstimateCosts: Estimate the remote query cost
+ * mysql_find_index_column: Find the index column expr is, or NULL if it is
+ * not a column leading an index of a table of rel.
  */
-static void
-mysqlEstimateCosts(PlannerInfo *root, RelOptInfo *baserel, Cost *startup_cost, Cost *total_cost, Oid foreigntableid)
+static MySQLIndexColumn *
+mysql_find_index_column(PlannerInfo *root, RelOptInfo *rel, Expr *expr)
 {
-	mysql_opt *options;
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) rel->fdw_private;
+	Var        *var;
+	char       *colname;
+	ListCell   *lc;
 
-	/* Fetch options */
-	options = mysql_get_options(foreigntableid);
+	while (expr != NULL && IsA(expr, RelabelType))
+		expr = ((RelabelType *) expr)->arg;
 
-	/* Local databases are probably faster */
-	if (strcmp(options->svr_address, "127.0.0.1") == 0 || strcmp(options->svr_address, "localhost") == 0)
-		*startup_cost = 10;
-	else
-		*startup_cost = 25;
+	if (expr == NULL || !IsA(expr, Var) || ((Var *) expr)->varattno <= 0 ||
+		!bms_is_member(((Var *) expr)->varno, rel->relids))
+		return NULL;
 
-	*total_cost = baserel->rows + *startup_cost;
-}
+	var = (Var *) expr;
+	colname = mysql_get_column_name(planner_rt_fetch(var->varno, root)->relid,
+									var->varattno);
+	foreach(lc, fpinfo->index_columns)
+	{
+		MySQLIndexColumn *column = (MySQLIndexColumn *) lfirst(lc);
+
+		if (pg_strcasecmp(colname, column->name) == 0)
+			return column;
+	}
 
+	return NULL;
+}
 
 /*
- * mysqlGetForeignPaths: Get the foreign paths
+ * mysql_get_rel_plan: Build the foreign scan of a join or grouping done by
+ * MySQL.
+ *
+ * Its rows come in the order of fdw_scan_tlist, which describes the scan
+ * tuple in place of a relation.
  */
-static void
-mysqlGetForeignPaths(PlannerInfo *root,RelOptInfo *baserel,Oid foreigntableid)
+static ForeignScan *
+mysql_get_rel_plan(PlannerInfo *root, RelOptInfo *foreignrel, ForeignPath *best_path,
+				   List *tlist, Plan *outer_plan)
 {
-	Cost startup_cost;
-	Cost total_cost;
+	MySQLFdwRelationInfo *fpinfo = (MySQLFdwRelationInfo *) foreignrel->fdw_private;
+	List           *fdw_scan_tlist;
+	List           *fdw_private;
+	List           *local_exprs;
+	List           *retrieved_attrs;
+	List           *params_list = NIL;
+	StringInfoData sql;
+	MySQLFetchMode fetch_mode;
+	int            limit_param = -1;
+	int            offset_param = -1;
 
-	/* Estimate costs */
-	mysqlEstimateCosts(root, baserel, &startup_cost, &total_cost, foreigntableid);
+	fdw_scan_tlist = mysql_build_tlist(foreignrel);
+	local_exprs = extract_actual_clauses(fpinfo->local_conds, false);
 
-	/* Create a ForeignPath node and add it as only possible path */
-	add_path(baserel, (Path *)
-			 create_foreignscan_path(root, baserel,
-#if PG_VERSION_NUM >= 90600
-									 NULL,		/* default pathtarget */
-#endif
-									 baserel->rows,
-									 startup_cost,
-									 total_cost,
-									 NIL,	/* no pathkeys */
-									 NULL,	/* no outer rel either */
-#if PG_VERSION_NUM >= 90500
-									 NULL,	/* no extra plan */
+	initStringInfo(&sql);
+	mysql_deparse_rel_select(&sql, root, foreignrel, fdw_scan_tlist, best_path->path.pathkeys,
+							 &retrieved_attrs, &params_list);
+
+	fetch_mode = fpinfo->options->fetch_mode;
+	if (fetch_mode == MYSQL_FETCH_AUTO)
+		fetch_mode = mysql_choose_fetch_mode(foreignrel, best_path->path.rows);
+
+	/* Items in the list must match enum FdwScanPrivateIndex, above */
+	fdw_private = list_make4(makeString(sql.data), retrieved_attrs, makeInteger(0),
+							 makeInteger(fetch_mode));
+	fdw_private = lappend(fdw_private, makeString(""));
+
+#if PG_VERSION_NUM >= 120000
+	/* The parameters of LIMIT and OFFSET come last, in that order */
+	if (IS_UPPER_REL(foreignrel) && fpinfo->stage == UPPERREL_FINAL)
+	{
+		Node *count = root->parse->limitCount;
+		Node *offset = root->parse->limitOffset;
+		int  nparams = list_length(params_list);
+
+		if (offset != NULL && IsA(offset, Param))
+			offset_param = --nparams;
+		if (count != NULL && IsA(count, Param))
+			limit_param = --nparams;
+	}
 #endif
-									 NULL));	/* no fdw_private data */
+	fdw_private = lappend(fdw_private, list_make2_int(limit_param, offset_param));
+	fdw_private = lappend(fdw_private, list_make2_int(0, 0));
+	fdw_private = lappend(fdw_private, makeString(pstrdup(fpinfo->remote.access)));
+
+	return make_foreignscan(tlist,
+							local_exprs,
+							0,			/* no scan relation */
+							params_list,
+							fdw_private,
+							fdw_scan_tlist,
+							NIL,
+							outer_plan);
 }
-
+#endif
 
 /*
  * mysqlGetForeignPlan: Get a foreign scan plan node
@@ -1114,13 +5192,27 @@ mysqlGetForeignPlan(
 	List           *remote_conds = NIL;
 
 	StringInfoData sql;
+	StringInfoData bounds_sql;
 	mysql_opt      *options;
 	List           *retrieved_attrs = NIL;
 	ListCell       *lc;
+	MySQLFetchMode fetch_mode;
+	bool           parallel = false;
+	AttrNumber     lookup_attnum = 0;
+
+#if PG_VERSION_NUM >= 90600
+	/* A join or grouping sent to MySQL has no foreign table of its own */
+	if (IS_JOIN_REL(baserel) || IS_UPPER_REL(baserel))
+		return mysql_get_rel_plan(root, baserel, best_path, tlist, outer_plan);
+#endif
 
 	/* Fetch options */
 	options = mysql_get_options(foreigntableid);
 
+	fetch_mode = options->fetch_mode;
+	if (fetch_mode == MYSQL_FETCH_AUTO)
+		fetch_mode = mysql_choose_fetch_mode(baserel, best_path->path.rows);
+
 	/*
 	 * Build the query string to be sent for execution, and identify
 	 * expressions to be sent as parameters.
@@ -1184,6 +5276,67 @@ mysqlGetForeignPlan(
 		mysql_append_where_clause(&sql, root, baserel, remote_conds,
 						  true, &params_list);
 
+#if PG_VERSION_NUM >= 90600
+	parallel = best_path->path.parallel_aware;
+
+	/*
+	 * A lookup on an integer key also asks for the keys that follow it,
+	 * whose rows the next rescans then find in the rescan cache.  The key
+	 * is the first parameter of the IN list, the others are bound by the
+	 * executor.  Rows to be locked are looked up one key at a time.
+	 */
+	if (options->lookup_batch_size > 1 && best_path->path.param_info != NULL &&
+		!baserel->is_tlist_pushdown && list_length(params_list) == 1 &&
+		baserel->relid != root->parse->resultRelation)
+	{
+		RestrictInfo *key_rinfo = mysql_find_lookup_key(baserel, remote_conds,
+														(Expr *) linitial(params_list),
+														&lookup_attnum);
+
+		if (key_rinfo != NULL)
+		{
+			List          *other_conds = list_delete_ptr(list_copy(remote_conds), key_rinfo);
+			List          *other_params = NIL;
+			RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+			Bitmapset     *attrs_used;
+
+			/* The rows must tell which key they are for */
+			attrs_used = bms_add_member(bms_copy(fpinfo->attrs_used),
+										lookup_attnum - FirstLowInvalidHeapAttributeNumber);
+
+			resetStringInfo(&sql);
+			retrieved_attrs = NIL;
+			mysql_deparse_select(&sql, root, baserel, attrs_used, options->svr_table,
+								 &retrieved_attrs, NULL);
+			if (other_conds)
+				mysql_append_where_clause(&sql, root, baserel, other_conds,
+										  true, &other_params);
+			Assert(other_params == NIL);
+			mysql_append_key_list(&sql, mysql_get_column_name(rte->relid, lookup_attnum),
+								  options->lookup_batch_size, other_conds == NIL);
+		}
+	}
+#endif
+
+	/* Each process of a parallel scan reads chunks of the key range */
+	initStringInfo(&bounds_sql);
+	if (parallel)
+	{
+		mysql_append_key_range(&sql, fpinfo->parallel_key, remote_conds == NIL);
+		mysql_deparse_key_bounds(&bounds_sql, options->svr_database, options->svr_table,
+								 fpinfo->parallel_key);
+
+		/* The chunks come one at a time, there is nothing to gain buffering them */
+		if (fetch_mode == MYSQL_FETCH_BUFFERED)
+			fetch_mode = MYSQL_FETCH_CURSOR;
+	}
+
+#if PG_VERSION_NUM >= 90600
+	/* Have MySQL sort the rows if the path is sorted */
+	if (best_path->path.pathkeys != NIL)
+		mysql_append_order_by_clause(&sql, root, baserel, best_path->path.pathkeys);
+#endif
+
 	if (baserel->relid == root->parse->resultRelation &&
 		(root->parse->commandType == CMD_UPDATE ||
 		root->parse->commandType == CMD_DELETE))
@@ -1197,7 +5350,13 @@ mysqlGetForeignPlan(
 	 * Items in the list must match enum FdwScanPrivateIndex, above.
 	 */
 
-	fdw_private = list_make3(makeString(sql.data), retrieved_attrs, makeInteger(baserel->is_tlist_pushdown));
+	fdw_private = list_make4(makeString(sql.data), retrieved_attrs, makeInteger(baserel->is_tlist_pushdown),
+							 makeInteger(fetch_mode));
+	fdw_private = lappend(fdw_private, makeString(bounds_sql.data));
+	fdw_private = lappend(fdw_private, list_make2_int(-1, -1));
+	fdw_private = lappend(fdw_private, list_make2_int(lookup_attnum,
+													  lookup_attnum > 0 ? options->lookup_batch_size : 0));
+	fdw_private = lappend(fdw_private, makeString(pstrdup(fpinfo->remote.access)));
 	/*
 	 * Create the ForeignScan node from target list, local filtering
 	 * expressions, remote parameter expressions, and FDW private information.
@@ -1219,6 +5378,109 @@ mysqlGetForeignPlan(
 	                       );
 }
 
+#if PG_VERSION_NUM >= 90600
+/*
+ * mysql_find_lookup_key: Find among the remote conditions of a
+ * parameterized scan the equality of an integer column of the table to
+ * param, the only parameter of its query.
+ *
+ * Returns the condition, setting *attnum to the column, or NULL.
+ */
+static RestrictInfo *
+mysql_find_lookup_key(RelOptInfo *baserel, List *remote_conds, Expr *param,
+					  AttrNumber *attnum)
+{
+	ListCell *lc;
+
+	if (!mysql_is_lookup_type(exprType((Node *) param)))
+		return NULL;
+
+	foreach(lc, remote_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr       *op = (OpExpr *) rinfo->clause;
+		Var          *var;
+
+		/* Only equalities can be turned into an IN list */
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2 ||
+			rinfo->mergeopfamilies == NIL)
+			continue;
+
+		if (equal(lsecond(op->args), param))
+			var = (Var *) linitial(op->args);
+		else if (equal(linitial(op->args), param))
+			var = (Var *) lsecond(op->args);
+		else
+			continue;
+
+		if (IsA(var, Var) && var->varno == baserel->relid && var->varattno > 0 &&
+			mysql_is_lookup_type(var->vartype))
+		{
+			*attnum = var->varattno;
+			return rinfo;
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+/*
+ * mysql_is_lookup_type: Tell whether the values of a type can be looked up
+ * several at a time, which is done for integers.
+ */
+static bool
+mysql_is_lookup_type(Oid type)
+{
+	return type == INT2OID || type == INT4OID || type == INT8OID;
+}
+
+/*
+ * mysql_choose_fetch_mode: Resolve the auto fetch mode of a scan expected
+ * to return rows rows each time it runs.
+ *
+ * A result expected to fit in work_mem is buffered locally, which frees
+ * the connection at once and spares MySQL the temporary table behind a
+ * cursor.  Larger results use a cursor.  Streaming is never chosen since
+ * it keeps the connection busy until the scan ends, which breaks other
+ * scans sharing it.
+ */
+static MySQLFetchMode
+mysql_choose_fetch_mode(RelOptInfo *baserel, double rows)
+{
+	double width;
+
+#if PG_VERSION_NUM >= 90600
+	width = baserel->reltarget->width;
+#else
+	width = baserel->width;
+#endif
+
+	if (rows * Max(width, 1) <= work_mem * 1024.0)
+		return MYSQL_FETCH_BUFFERED;
+
+	return MYSQL_FETCH_CURSOR;
+}
+
+/*
+ * mysql_fetch_mode_name: Name of a fetch mode, as shown by EXPLAIN
+ */
+static const char *
+mysql_fetch_mode_name(MySQLFetchMode fetch_mode)
+{
+	switch (fetch_mode)
+	{
+		case MYSQL_FETCH_CURSOR:
+			return "cursor";
+		case MYSQL_FETCH_BUFFERED:
+			return "buffered";
+		case MYSQL_FETCH_STREAMING:
+			return "streaming";
+		default:
+			return "auto";
+	}
+}
+
 /*
  * mysqlAnalyzeForeignTable: Implement stats collection
  */
@@ -1245,7 +5507,7 @@ mysqlAnalyzeForeignTable(Relation relation, AcquireSampleRowsFunc *func, BlockNu
 	options = mysql_get_options(foreignTableId);
 
 	/* Connect to the server */
-	conn = mysql_get_connection(server, user, options);
+	conn = mysql_get_connection(server, user, options, false);
 
 	/* Build the query */
 	initStringInfo(&sql);
@@ -1455,7 +5717,7 @@ mysqlBeginForeignModify(ModifyTableState *mtstate,
 
 	fmstate->rel = rel;
 	fmstate->mysqlFdwOptions = mysql_get_options(foreignTableId);
-	fmstate->conn = mysql_get_connection(server, user, fmstate->mysqlFdwOptions);
+	fmstate->conn = mysql_get_connection(server, user, fmstate->mysqlFdwOptions, false);
 
 	fmstate->query = strVal(list_nth(fdw_private, 0));
 	fmstate->retrieved_attrs = (List *) list_nth(fdw_private, 1);
@@ -1603,7 +5865,8 @@ mysqlExecForeignInsert(EState *estate,
 			break;
 		}
 	}
-	/* Execute the query */
+	/* Execute the query, once MySQL is done with any scan's prefetch */
+	mysql_finish_pending_fetch(fmstate->conn);
 	if (_mysql_stmt_execute(fmstate->stmt) != 0)
 	{
 		switch(_mysql_stmt_errno(fmstate->stmt))
@@ -1697,6 +5960,7 @@ mysqlExecForeignUpdate(EState *estate,
 				 ));
 	}
 
+	mysql_finish_pending_fetch(fmstate->conn);
 	if (_mysql_stmt_execute(fmstate->stmt) != 0)
 	{
 		switch(_mysql_stmt_errno(fmstate->stmt))
@@ -1809,6 +6073,7 @@ mysqlExecForeignDelete(EState *estate,
 				 ));
 	}
 
+	mysql_finish_pending_fetch(fmstate->conn);
 	if (_mysql_stmt_execute(fmstate->stmt) != 0)
 	{
 		switch(_mysql_stmt_errno(fmstate->stmt))
@@ -1854,6 +6119,7 @@ mysqlEndForeignModify(EState *estate, ResultRelInfo *resultRelInfo)
 
 	if (festate && festate->stmt)
 	{
+		mysql_finish_pending_fetch(festate->conn);
 		_mysql_stmt_close(festate->stmt);
 		festate->stmt = NULL;
 	}
@@ -1901,7 +6167,7 @@ mysqlImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
     server = GetForeignServer(serverOid);
     user = GetUserMapping(GetUserId(), server->serverid);
     options = mysql_get_options(serverOid);
-    conn = mysql_get_connection(server, user, options);
+    conn = mysql_get_connection(server, user, options, false);
 
     /* Create workspace for strings */
     initStringInfo(&buf);
@@ -2137,34 +6403,41 @@ mysqlImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
  */
 static void
 prepare_query_params(PlanState *node,
-					 List *fdw_exprs,
-					 int numParams,
-					 FmgrInfo **param_flinfo,
-					 List **param_exprs,
-					 const char ***param_values,
-					 Oid **param_types)
+					 MySQLFdwExecState *festate,
+					 List *fdw_exprs)
 {
+	int			numParams = festate->numParams;
 	int			i;
 	ListCell   *lc;
 
 	Assert(numParams > 0);
 
-	/* Prepare for output conversion of parameters used in remote query. */
-	*param_flinfo = (FmgrInfo *) palloc0(sizeof(FmgrInfo) * numParams);
-
-	*param_types = (Oid *) palloc0(sizeof(Oid) * numParams);
+	festate->param_types = (Oid *) palloc0(sizeof(Oid) * numParams);
+	festate->param_typlen = (int16 *) palloc0(sizeof(int16) * numParams);
+	festate->param_typbyval = (bool *) palloc0(sizeof(bool) * numParams);
+	festate->param_datums = (Datum *) palloc0(sizeof(Datum) * numParams);
+	festate->param_nulls = (bool *) palloc0(sizeof(bool) * numParams);
+	festate->param_cxt = (MemoryContext *) palloc0(sizeof(MemoryContext) * numParams);
 
 	i = 0;
 	foreach(lc, fdw_exprs)
 	{
 		Node	   *param_expr = (Node *) lfirst(lc);
-		Oid			typefnoid;
-		bool		isvarlena;
 
-		(*param_types)[i] = exprType(param_expr);
+		festate->param_types[i] = exprType(param_expr);
+		get_typlenbyval(festate->param_types[i],
+						&festate->param_typlen[i],
+						&festate->param_typbyval[i]);
 
-		getTypeOutputInfo(exprType(param_expr), &typefnoid, &isvarlena);
-		fmgr_info(typefnoid, &(*param_flinfo)[i]);
+		festate->param_cxt[i] = AllocSetContextCreate(node->state->es_query_cxt,
+													  "mysql_fdw parameter",
+#if PG_VERSION_NUM >= 110000
+													  ALLOCSET_SMALL_SIZES);
+#else
+													  ALLOCSET_SMALL_MINSIZE,
+													  ALLOCSET_SMALL_INITSIZE,
+													  ALLOCSET_SMALL_MAXSIZE);
+#endif
 		i++;
 	}
 
@@ -2177,38 +6450,34 @@ prepare_query_params(PlanState *node,
 	 * about Param evaluation.)
 	 */
 #if PG_VERSION_NUM >= 100000
-	*param_exprs = ExecInitExprList(fdw_exprs, node);
+	festate->param_exprs = ExecInitExprList(fdw_exprs, node);
 #else
-	*param_exprs = (List *) ExecInitExpr((Expr *) fdw_exprs, node);
+	festate->param_exprs = (List *) ExecInitExpr((Expr *) fdw_exprs, node);
 #endif
-
-	/* Allocate buffer for text form of query parameters. */
-	*param_values = (const char **) palloc0(numParams * sizeof(char *));
 }
 
 /*
- * Construct array of query parameter values in text format.
+ * Evaluate the query parameters and bind those whose value differs from
+ * the one bound for the previous scan.  Each bound value lives in a context
+ * of its own, which is reset when the parameter is bound again.
+ *
+ * Returns true if any parameter was bound again.
  */
-static void
+static bool
 process_query_params(ExprContext *econtext,
-					 FmgrInfo *param_flinfo,
-					 List *param_exprs,
-					 const char **param_values,
-					 MYSQL_BIND **mysql_bind_buf,
-					 Oid *param_types)
+					 MySQLFdwExecState *festate)
 {
-//	int			nestlevel;
+	bool		changed = false;
 	int			i;
 	ListCell   *lc;
 
-//	nestlevel = set_transmission_modes();
-
 	i = 0;
-	foreach(lc, param_exprs)
+	foreach(lc, festate->param_exprs)
 	{
 		ExprState  *expr_state = (ExprState *) lfirst(lc);
 		Datum		expr_value;
 		bool		isNull;
+		MemoryContext oldcontext;
 
 		/* Evaluate the parameter expression */
 #if PG_VERSION_NUM >= 100000
@@ -2216,65 +6485,316 @@ process_query_params(ExprContext *econtext,
 #else
 		expr_value = ExecEvalExpr(expr_state, econtext, &isNull, NULL);
 #endif
-		mysql_bind_sql_var(param_types[i], i, expr_value, *mysql_bind_buf, &isNull);
 
 		/*
-		 * Get string representation of each parameter value by invoking
-		 * type-specific output function, unless the value is null.
+		 * MySQL takes no NULL or negative LIMIT and OFFSET, check them as the
+		 * Limit node would.  NULL means no limit.
 		 */
+		if (i == festate->limit_param || i == festate->offset_param)
+		{
+			if (isNull)
+			{
+				expr_value = Int64GetDatum(i == festate->limit_param ? PG_INT64_MAX : 0);
+				isNull = false;
+			}
+			else if (DatumGetInt64(expr_value) < 0)
+			{
+				if (i == festate->limit_param)
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_ROW_COUNT_IN_LIMIT_CLAUSE),
+							 errmsg("LIMIT must not be negative")));
+				else
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_ROW_COUNT_IN_RESULT_OFFSET_CLAUSE),
+							 errmsg("OFFSET must not be negative")));
+			}
+		}
+
+		/* Keep the buffer of a value that did not change */
+		if (festate->params_known &&
+			isNull == festate->param_nulls[i] &&
+			(isNull || datumIsEqual(expr_value, festate->param_datums[i],
+									festate->param_typbyval[i],
+									festate->param_typlen[i])))
+		{
+			i++;
+			continue;
+		}
+
+		MemoryContextReset(festate->param_cxt[i]);
+		oldcontext = MemoryContextSwitchTo(festate->param_cxt[i]);
+
+		festate->param_nulls[i] = isNull;
 		if (isNull)
-			param_values[i] = NULL;
+			festate->param_datums[i] = (Datum) 0;
 		else
-			param_values[i] = OutputFunctionCall(&param_flinfo[i], expr_value);
+			festate->param_datums[i] = datumCopy(expr_value,
+												 festate->param_typbyval[i],
+												 festate->param_typlen[i]);
+
+		mysql_bind_sql_var(festate->param_types[i], i, festate->param_datums[i],
+						   festate->param_binds, &festate->param_nulls[i]);
+
+		MemoryContextSwitchTo(oldcontext);
+		changed = true;
 		i++;
 	}
 
-//	reset_transmission_modes(nestlevel);
+	return changed;
 }
 
 /*
- * Create cursor for node's query with current parameter values.
+ * bind_query_params: Bind the current parameter values to the statement of
+ * the scan.  The statement is only told about its parameters again when one
+ * of them changed, as the buffers of the others are still in place.
+ *
+ * Returns true if any parameter value differs from the previous scan.
  */
-static void
-create_cursor(ForeignScanState *node)
+static bool
+bind_query_params(ForeignScanState *node)
 {
 	MySQLFdwExecState   *festate = (MySQLFdwExecState *) node->fdw_state;
 	ExprContext *econtext = node->ss.ps.ps_ExprContext;
-	int			numParams = festate->numParams;
-	const char **values = festate->param_values;
-	MYSQL_BIND *mysql_bind_buffer = NULL;
+	MemoryContext oldcontext;
+	bool		changed = false;
 
-	/*
-	 * Construct array of query parameter values in text format.  We do the
-	 * conversions in the short-lived per-tuple context, so as not to cause a
-	 * memory leak over repeated scans.
-	 */
-	if (numParams > 0)
-	{
-		MemoryContext oldcontext;
+	if (festate->param_binds == NULL)
+		return false;
 
+	/* Evaluate the expressions in the short-lived per-tuple context */
+	if (festate->numParams > 0)
+	{
 		oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+		changed = process_query_params(econtext, festate);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	if (!festate->params_known || changed)
+	{
+		if (_mysql_stmt_bind_param(festate->stmt, festate->param_binds))
+			mysql_stmt_error_report(festate, "failed to bind the MySQL query parameters");
+		festate->params_known = true;
+	}
+
+	return changed;
+}
 
-		mysql_bind_buffer = (MYSQL_BIND*) palloc0(sizeof(MYSQL_BIND) * numParams);
+/*
+ * mysql_reset_scan: Discard what is left of the result of the previous
+ * scan, closing its cursor on the server.  The statement stays prepared
+ * and keeps its parameters bound.
+ */
+static void
+mysql_reset_scan(MySQLFdwExecState *festate)
+{
+	mysql_end_streaming(festate);
+	mysql_finish_pending_fetch(festate->conn);
 
-		process_query_params(econtext,
-							 festate->param_flinfo,
-							 festate->param_exprs,
-							 values,
-							 &mysql_bind_buffer,
-							 festate->param_types);
+	if (_mysql_stmt_reset(festate->stmt))
+		mysql_stmt_error_report(festate, "failed to reset the MySQL query");
+}
 
-		_mysql_stmt_bind_param(festate->stmt, mysql_bind_buffer);
+/*
+ * mysql_start_scan: Execute the query of the scan, on the first call for
+ * rows after the scan began or was restarted.
+ */
+static void
+mysql_start_scan(MySQLFdwExecState *festate)
+{
+	festate->scan_started = true;
 
-		/* Mark the cursor as created, and show no tuples have been retrieved */
-		festate->cursor_exists = true;
+	if (mysql_execute_scan(festate) != 0)
+	{
+		switch(_mysql_stmt_errno(festate->stmt))
+		{
+			case CR_NO_ERROR:
+				break;
 
-		MemoryContextSwitchTo(oldcontext);
+			case CR_OUT_OF_MEMORY:
+			case CR_SERVER_GONE_ERROR:
+			case CR_SERVER_LOST:
+			{
+				char *err = pstrdup(_mysql_error(festate->conn));
+				mysql_rel_connection(festate->conn);
+				ereport(ERROR,
+							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+							errmsg("failed to execute the MySQL query: \n%s", err)));
+			}
+			break;
+			case CR_COMMANDS_OUT_OF_SYNC:
+			case CR_UNKNOWN_ERROR:
+			default:
+			{
+				char *err = pstrdup(_mysql_error(festate->conn));
+				ereport(ERROR,
+							(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+							errmsg("failed to execute the MySQL query: \n%s", err)));
+			}
+			break;
+		}
 	}
 }
 
+/*
+ * mysql_end_streaming: Forget that the streaming result of a scan is being
+ * read, once the scan is done with it.
+ */
+static void
+mysql_end_streaming(MySQLFdwExecState *festate)
+{
+	if (mysql_get_streaming_scan(festate->conn) == festate)
+		mysql_set_streaming_scan(festate->conn, NULL);
+}
+
 Datum
 mysql_fdw_version(PG_FUNCTION_ARGS)
 {
 	PG_RETURN_INT32(CODE_VERSION);
 }
+
+/*
+ * mysql_fdw_calibrate: Measure the round trip time to a server and the
+ * time it takes to send a byte, and store them as its rtt_ms and
+ * fdw_byte_cost options, for the planner to cost its queries with.
+ *
+ * The best of several runs is kept, the others having been slowed down by
+ * something else.
+ */
+Datum
+mysql_fdw_calibrate(PG_FUNCTION_ARGS)
+{
+	char          *servername = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	ForeignServer *server = GetForeignServerByName(servername, false);
+	UserMapping   *user = GetUserMapping(GetUserId(), server->serverid);
+	mysql_opt     *options = mysql_get_options(server->serverid);
+	MYSQL         *conn;
+	char          *transfer_query;
+	double        rtt_ms = 0;
+	double        transfer_ms = 0;
+	double        byte_cost;
+	TupleDesc     tupdesc;
+	Datum         values[2];
+	bool          nulls[2] = {false, false};
+	int           i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	conn = mysql_get_connection(server, user, options, false);
+
+	/* A query with nothing to do is a round trip */
+	for (i = 0; i < MYSQL_CALIBRATE_RUNS; i++)
+	{
+		double ms = mysql_time_query(conn, "SELECT 1");
+
+		rtt_ms = (i == 0) ? ms : Min(rtt_ms, ms);
+	}
+
+	/* One that sends a long value back tells the time for its bytes */
+	transfer_query = psprintf("SELECT REPEAT('x', %d)", MYSQL_CALIBRATE_BYTES);
+	for (i = 0; i < MYSQL_CALIBRATE_RUNS; i++)
+	{
+		double ms = mysql_time_query(conn, transfer_query);
+
+		transfer_ms = (i == 0) ? ms : Min(transfer_ms, ms);
+	}
+	byte_cost = Max(transfer_ms - rtt_ms, 0) / MYSQL_CALIBRATE_BYTES * MYSQL_MS_COST;
+
+	mysql_set_server_option(server, "rtt_ms", rtt_ms);
+	mysql_set_server_option(server, "fdw_byte_cost", byte_cost);
+
+	values[0] = Float8GetDatum(rtt_ms);
+	values[1] = Float8GetDatum(byte_cost);
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * mysql_fdw_invalidate_estimates: Forget the row estimates of the queries
+ * sent to a server, or to any server when it is NULL, so that the next
+ * plans ask MySQL again.
+ *
+ * Returns the number of estimates forgotten.
+ */
+Datum
+mysql_fdw_invalidate_estimates(PG_FUNCTION_ARGS)
+{
+	HTAB               *htab = mysql_estimate_cache();
+	Oid                serverid = InvalidOid;
+	HASH_SEQ_STATUS    status;
+	MySQLEstimateEntry *entry;
+	int64              removed = 0;
+
+	if (!PG_ARGISNULL(0))
+		serverid = GetForeignServerByName(text_to_cstring(PG_GETARG_TEXT_PP(0)), false)->serverid;
+
+	if (htab == NULL)
+		PG_RETURN_INT64(0);
+
+	if (estimate_shared)
+		LWLockAcquire(estimate_shared->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, htab);
+	while ((entry = (MySQLEstimateEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (OidIsValid(serverid) && entry->key.serverid != serverid)
+			continue;
+		hash_search(htab, &entry->key, HASH_REMOVE, NULL);
+		removed++;
+	}
+
+	if (estimate_shared)
+		LWLockRelease(estimate_shared->lock);
+
+	PG_RETURN_INT64(removed);
+}
+
+/*
+ * mysql_time_query: Run a query on conn, reading its whole result, and
+ * return the time it took in milliseconds.
+ */
+static double
+mysql_time_query(MYSQL *conn, const char *query)
+{
+	instr_time start;
+	instr_time duration;
+	MYSQL_RES  *result;
+
+	INSTR_TIME_SET_CURRENT(start);
+	result = mysql_run_query(conn, query);
+	if (result != NULL)
+		_mysql_free_result(result);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	return INSTR_TIME_GET_MILLISEC(duration);
+}
+
+/*
+ * mysql_set_server_option: Give an option of a server a value, as ALTER
+ * SERVER would, which checks that the user owns it.
+ */
+static void
+mysql_set_server_option(ForeignServer *server, const char *name, double value)
+{
+	bool     exists = false;
+	ListCell *lc;
+	char     *sql;
+
+	foreach(lc, server->options)
+	{
+		DefElem *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, name) == 0)
+			exists = true;
+	}
+
+	sql = psprintf("ALTER SERVER %s OPTIONS (%s %s '%g')",
+				   quote_identifier(server->servername),
+				   exists ? "SET" : "ADD", name, value);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+	if (SPI_execute(sql, false, 0) != SPI_OK_UTILITY)
+		elog(ERROR, "failed to set option \"%s\" of server \"%s\"", name, server->servername);
+	SPI_finish();
+}
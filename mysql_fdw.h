@@ -26,26 +26,91 @@
 #undef list_free
 
 #include "access/tupdesc.h"
+#include "datatype/timestamp.h"
 #include "foreign/foreign.h"
+#include "lib/ilist.h"
 #include "lib/stringinfo.h"
+#include "nodes/execnodes.h"
 #if PG_VERSION_NUM < 120000
 	#include "nodes/relation.h"
 #else
 	#include "nodes/pathnodes.h"
 #endif
 
+#include "storage/lwlock.h"
+#include "storage/spin.h"
+#include "utils/hsearch.h"
 #include "utils/rel.h"
+#include "utils/tuplestore.h"
 
 #define MYSQL_PREFETCH_ROWS	100
+#define MYSQL_FETCH_MIN		10
+#define MYSQL_BATCH_ROWS	100
+#define MYSQL_MAX_BATCH_ROWS	100000
+#define MYSQL_MAX_LOOKUP_KEYS	65535	/* placeholders of a MySQL statement */
 #define MYSQL_BLKSIZ		(1024 * 4)
 #define MYSQL_PORT			3306
-#define MAXDATALEN			1024 * 64
+#define MYSQL_MIN_BUFFER	32
+#define MYSQL_INIT_BUFFER	(1024 * 8)
+#define MYSQL_MAX_BUFFER	(1024 * 1024)
+#define MYSQL_FETCH_CHUNK	(1024 * 256)
+#define MYSQL_PARALLEL_SPLIT	2
+#define MYSQL_PARALLEL_CHUNKS	1024
+#define MYSQL_STARTUP_COST	100.0	/* the defaults of postgres_fdw */
+#define MYSQL_TUPLE_COST	0.01
+#define MYSQL_MS_COST		100.0	/* planner cost units per millisecond */
+#define MYSQL_REMOTE_COST_FACTOR	1.0	/* planner cost units per MySQL cost unit */
+#define MYSQL_CALIBRATE_RUNS	10
+#define MYSQL_CALIBRATE_BYTES	(1024 * 512)
+#define MYSQL_ESTIMATE_PREFIX	7	/* characters of a string constant told apart */
+#define MYSQL_ESTIMATE_QUERY_LEN	2048	/* longest normalized query whose estimate is kept */
 
 #define WAIT_TIMEOUT		0
 #define INTERACTIVE_TIMEOUT 0
 
 
 #define CR_NO_ERROR 0
+
+/*
+ * MariaDB's client library can fetch without blocking, which lets a scan
+ * ask for its next rows while the executor works on the current ones.
+ * With MySQL's library, or if the entry points are missing at run time,
+ * scans simply block.
+ */
+#if defined(MYSQL_WAIT_READ) && PG_VERSION_NUM >= 90500
+#define MYSQL_FDW_NONBLOCK
+#endif
+
+/*
+ * MySQL's client library compresses with zstd as well as zlib from 8.0.18
+ * on.  MariaDB's has only the zlib compression of the classic protocol.
+ */
+#if MYSQL_VERSION_ID >= 80018 && !defined(MARIADB_BASE_VERSION) && \
+	!defined(MARIADB_PACKAGE_VERSION_ID)
+#define MYSQL_FDW_ZSTD
+#endif
+
+/*
+ * Compression of the traffic with the MySQL server
+ */
+typedef enum MySQLCompression
+{
+	MYSQL_COMPRESS_NONE,
+	MYSQL_COMPRESS_ZLIB,
+	MYSQL_COMPRESS_ZSTD
+} MySQLCompression;
+
+/*
+ * How a scan retrieves its rows from MySQL
+ */
+typedef enum MySQLFetchMode
+{
+	MYSQL_FETCH_AUTO,           /* choose at plan time from the estimates */
+	MYSQL_FETCH_CURSOR,         /* server-side read-only cursor */
+	MYSQL_FETCH_BUFFERED,       /* drain into a local tuplestore first */
+	MYSQL_FETCH_STREAMING       /* read the rows as the server sends them */
+} MySQLFetchMode;
+
 /*
  * Options structure to store the MySQL
  * server information
@@ -62,6 +127,21 @@ typedef struct mysql_opt
 	char          *svr_init_command;      /* MySQL SQL statement to execute when connecting to the MySQL server. */
 	unsigned long max_blob_size;          /* Max blob size to read without truncation */
 	bool          use_remote_estimate;    /* use remote estimate for rows */
+	unsigned long fetch_size;             /* rows fetched per round trip */
+	bool          fetch_adaptive;         /* grow the fetch size as the scan goes */
+	MySQLFetchMode fetch_mode;            /* how the rows are retrieved */
+	int           batch_size;             /* rows converted in one go */
+	bool          async_capable;          /* scans may run asynchronously */
+	int           parallel_workers;       /* workers of a parallel scan, 0 for none */
+	int           lookup_batch_size;      /* keys looked up per round trip, 0 for one */
+	MySQLCompression compression;         /* compression of scans that read much */
+	int           compression_level;      /* zstd level, 0 for the default */
+	int           compression_threshold;  /* least estimated kB of a compressed scan */
+	double        fdw_startup_cost;       /* cost of starting a query on the server */
+	double        fdw_tuple_cost;         /* cost of each row sent by the server */
+	double        fdw_byte_cost;          /* cost of each byte of them */
+	double        rtt_ms;                 /* round trip time to the server */
+	double        remote_cost_factor;     /* weight of the cost MySQL estimates */
 	
 	// SSL parameters; unused options may be given as NULL
 	char          *ssl_key;               /* MySQL SSL: path to the key file */
@@ -77,18 +157,182 @@ typedef struct mysql_column
 	unsigned long length;
 	bool          is_null;
 	bool          error;
+	bool          varlena;      /* value is built in place after a varlena header */
+	bool          verify;       /* text must be fully checked, not only for NUL bytes */
+	Datum         spill;        /* bind buffer, while value holds a value too long for it */
+	bool          cut;          /* value was cut at max_blob_size */
 	MYSQL_BIND    *_mysql_bind;
 } mysql_column;
 
+struct mysql_converter;
+
+typedef Datum (*mysql_convert_fn) (struct mysql_converter *conv, mysql_column *column);
+
+/*
+ * Conversion state of one retrieved column, resolved once per scan so that
+ * fetching a row does not need any catalog access.
+ */
+typedef struct mysql_converter
+{
+	int              attnum;          /* index into the scan tuple slot */
+	Oid              pgtype;          /* PostgreSQL type of the column */
+	int32            typmod;          /* typmod passed to the input function */
+	Oid              typioparam;      /* parameter to pass to the input function */
+	FmgrInfo         typinput;        /* type input function, for the text path */
+	mysql_convert_fn convert;         /* routine converting each fetched value */
+	bool             in_qual;         /* needed by the local conditions */
+	long             ncalls;          /* values parsed by the input function */
+	bool             warned;          /* a cut value has been reported */
+} mysql_converter;
+
+/*
+ * Rows fetched and converted in one go, stored column by column so that
+ * handing them out one at a time is cheap.
+ */
+typedef struct mysql_batch
+{
+	int           size;                   /* capacity, in rows */
+	int           nrows;                  /* rows in the batch */
+	int           nfetched;               /* rows fetched for it, filtered out or not */
+	int           next;                   /* next row to return */
+	bool          done;                   /* no rows left on the server */
+	Datum         **values;               /* per retrieved column, its values */
+	bool          **isnull;               /* per retrieved column, its null flags */
+} mysql_batch;
+
 typedef struct mysql_table
 {
 	MYSQL_RES *_mysql_res;
 	MYSQL_FIELD *_mysql_fields;
 
 	mysql_column *column;
+	mysql_converter *converter;
+	int ncolumns;
+	bool spilled;               /* a value of the current row was fetched on its own or cut */
 	MYSQL_BIND *_mysql_bind;
 } mysql_table;
 
+/*
+ * State of a parallel scan shared by its processes in dynamic shared
+ * memory.  The key range [first, last] is handed out in chunks of
+ * 1 / (MYSQL_PARALLEL_SPLIT * nparticipants) of what remains, so that the
+ * chunks shrink towards the end and no process is left with a long one
+ * while the others are idle.  The range is cut in at most about
+ * MYSQL_PARALLEL_CHUNKS chunks.
+ */
+typedef struct MySQLParallelScan
+{
+	slock_t     mutex;              /* protects the fields below */
+	int64       first;              /* smallest key value */
+	int64       last;               /* largest key value */
+	int64       next;               /* first key value not handed out yet */
+	int64       min_chunk;          /* smallest span handed out */
+	bool        exhausted;          /* whole range handed out */
+	int         nparticipants;      /* processes taking part in the scan */
+} MySQLParallelScan;
+
+/*
+ * Rows of a rescan, kept so that a later rescan with the same parameter
+ * values can return them without asking MySQL again.  The results of a
+ * scan are dropped least recently used first once they hold more than
+ * work_mem.
+ */
+typedef struct MySQLCacheKey
+{
+	char        *data;              /* parameter values, one after the other */
+	Size        len;                /* length of data */
+} MySQLCacheKey;
+
+typedef struct MySQLCacheEntry
+{
+	MySQLCacheKey key;              /* hash key, must be first */
+	dlist_node  lru;                /* place among the results, recent first */
+	MinimalTuple *tuples;           /* rows of the result */
+	int         ntuples;            /* number of rows */
+	int         maxtuples;          /* allocated length of tuples */
+	Size        size;               /* memory held by the result */
+	bool        complete;           /* scan went through to the end */
+} MySQLCacheEntry;
+
+/*
+ * Row estimates of remote queries, kept so that planning the same query
+ * again does not ask MySQL.  Queries differing only by close enough
+ * constants share their estimate.  The cache is in shared memory when the
+ * library is preloaded, and local to each backend otherwise.
+ */
+typedef struct MySQLEstimateKey
+{
+	Oid         serverid;           /* server the query is sent to */
+	uint32      len;                /* length of the normalized query */
+	uint32      hash;               /* and its hash */
+} MySQLEstimateKey;
+
+/*
+ * What EXPLAIN of a query tells of it.  The access is a short description
+ * of how MySQL reads each table, "" if unknown.
+ */
+typedef struct MySQLRemoteEstimate
+{
+	double      rows;               /* rows of the result, 0 if unknown */
+	double      cost;               /* in MySQL's cost units, 0 if unknown */
+	bool        materialized;       /* all read before the first row is sent */
+	char        access[NAMEDATALEN];
+} MySQLRemoteEstimate;
+
+/*
+ * State of the parse of EXPLAIN FORMAT=JSON by mysql_explain_json.
+ */
+typedef struct MySQLExplainJson
+{
+	MySQLRemoteEstimate *estimate;
+	char           *key;            /* of the value coming, NULL if none */
+	int            depth;
+	int            table_depth;     /* of the table being read, 0 if none */
+	int            parts_depth;     /* of its used_key_parts, 0 if none */
+	int            best_depth;      /* of the tables counted */
+	int            cost_depth;      /* of the query_cost taken */
+	double         query_cost;
+	double         table_cost;      /* sum of those of the tables counted */
+	double         rows;
+	/* Figures of the table being read */
+	double         produced;
+	double         examined;
+	double         filtered;
+	double         read_cost;
+	double         eval_cost;
+	char           *type;
+	char           *used_key;
+	StringInfoData parts;
+} MySQLExplainJson;
+
+typedef struct MySQLEstimateEntry
+{
+	MySQLEstimateKey key;           /* hash key, must be first */
+	MySQLRemoteEstimate estimate;   /* estimate given by MySQL */
+	TimestampTz stored;             /* when it was */
+	char        query[MYSQL_ESTIMATE_QUERY_LEN];    /* normalized query, as the hash may collide */
+} MySQLEstimateEntry;
+
+typedef struct MySQLEstimateShared
+{
+	LWLock      *lock;              /* protects the hash table */
+} MySQLEstimateShared;
+
+/*
+ * What planning a foreign table asked MySQL about the table itself, kept
+ * by each backend for as long as the row estimates.  Changing the options
+ * of a foreign table or server forgets all of it.
+ */
+typedef struct MySQLTableMeta
+{
+	Oid         relid;              /* hash key: the foreign table */
+	TimestampTz stored;             /* when it was looked up */
+	bool        key_known;          /* has parallel_key been looked up? */
+	char        parallel_key[NAMEDATALEN];  /* column to split scans on, or "" */
+	bool        indexes_known;      /* have index_columns been looked up? */
+	List        *index_columns;     /* as MySQLIndexColumn, in TopMemoryContext */
+} MySQLTableMeta;
+
 /*
  * FDW-specific information for ForeignScanState 
  * fdw_state.
@@ -102,12 +346,20 @@ typedef struct MySQLFdwExecState
 	Relation        rel;                /* relcache entry for the foreign table */
 	List            *retrieved_attrs;   /* list of target attribute numbers */
 
-	bool		cursor_exists;	    /* have we created the cursor? */
+	bool		params_bound;	    /* are the parameters of this scan bound? */
+	bool		params_known;	    /* do param_datums hold values bound before? */
+	bool		scan_started;	    /* has the current scan executed its query? */
 	int		numParams;	    /* number of parameters passed to query */
-	FmgrInfo	*param_flinfo;	    /* output conversion functions for them */
+	int		limit_param;	    /* the one giving LIMIT, or -1 */
+	int		offset_param;	    /* the one giving OFFSET, or -1 */
 	List		*param_exprs;	    /* executable expressions for param values */
-	const char	**param_values;	    /* textual values of query parameters */
 	Oid		*param_types;	    /* type of query parameters */
+	int16		*param_typlen;	    /* their type lengths */
+	bool		*param_typbyval;    /* are they passed by value? */
+	Datum		*param_datums;	    /* values the parameters are bound to */
+	bool		*param_nulls;	    /* which of them are NULL */
+	MemoryContext	*param_cxt;	    /* one per parameter, holds its bound value */
+	MYSQL_BIND	*param_binds;	    /* parameters, then the parallel key range */
 
 	int             p_nums;             /* number of parameters to transmit */
 	FmgrInfo        *p_flinfo;          /* output conversion functions for them */
@@ -117,11 +369,149 @@ typedef struct MySQLFdwExecState
 	List            *attr_list;         /* query attribute list */
 	List            *column_list;       /* Column list of MySQL Column structures */
 	bool 			is_tlist_pushdown;      /* pushdown target list or not */
+	long            type_lookups;       /* catalog lookups done to set up conversions */
+	unsigned long   max_blob_size;      /* longest value to fetch, 0 for no limit */
+	unsigned long   fetch_size;         /* rows fetched per round trip */
+	unsigned long   fetch_max;          /* largest adaptive fetch size */
+	unsigned long   fetch_left;         /* rows left before the next round trip */
+	bool            fetch_adaptive;     /* grow the fetch size as the scan goes */
+	MySQLFetchMode  fetch_mode;         /* how the rows are retrieved */
+	Tuplestorestate *store;             /* rows of a buffered scan */
+	TupleTableSlot  *store_slot;        /* slot to read the store, if needed */
+	bool            store_filled;       /* whole result is in the store */
+	bool            store_partial;      /* only the rest of a streaming result is */
+	mysql_batch     batch;              /* rows fetched but not yet returned */
+	bool            fetch_pending;      /* next row was asked for without waiting */
+	int             async_status;       /* events the pending fetch waits for */
+	int             async_ret;          /* result of the pending fetch once done */
+	bool            async_mode;         /* driven by asynchronous requests */
+	char            *bounds_query;      /* query finding the key range, if parallel */
+	bool            parallel;           /* scan reads chunks of a key range */
+	MySQLParallelScan *pscan;           /* shared state, NULL without workers */
+	long long       range[2];           /* bounds of the chunk being read */
+	int             nchunks;            /* chunks read by this process */
+	bool            cache_ok;           /* can rescans be served from the cache? */
+	HTAB            *cache;             /* results of rescans by parameter values */
+	dlist_head      cache_lru;          /* cached results, recently used first */
+	MemoryContext   cache_cxt;          /* holds the cached results */
+	Size            cache_size;         /* memory held by them */
+	MySQLCacheEntry *cache_fill;        /* result being collected, if any */
+	MySQLCacheEntry *cache_read;        /* result being returned, if any */
+	int             cache_pos;          /* next row of cache_read */
+	TupleTableSlot  *cache_slot;        /* slot to read cached rows, if needed */
+	long            cache_hits;         /* rescans served from the cache */
+	long            cache_misses;       /* rescans that had to ask MySQL */
+	int             lookup_batch;       /* keys a lookup asks for, 0 if not batched */
+	int             lookup_attnum;      /* column of the lookup key in the rows */
+	Oid             lookup_type;        /* and its type */
+	long long       *lookup_keys;       /* the keys after the one looked up */
+	long            lookup_batches;     /* lookups that asked for several keys */
+	char            *remote_access;     /* how MySQL reads the tables, or "" */
+	PlanState       *scan_state;        /* the scan node */
+	/*
+	 * local conditions checked before the other columns are converted, if
+	 * any, instead of by the executor
+	 */
+#if PG_VERSION_NUM >= 100000
+	ExprState       *late_qual;
+#else
+	List            *late_qual;
+#endif
+	Size            mem_peak;           /* most memory held by one batch of rows */
+#if PG_VERSION_NUM < 130000
+	Size            batch_bytes;        /* bytes of values in the current batch */
+#endif
 	/* working memory context */
 	MemoryContext   temp_cxt;           /* context for per-tuple temporary data */
 } MySQLFdwExecState;
 
 
+/*
+ * FDW-specific planner information kept in RelOptInfo.fdw_private for a
+ * foreign table or a join of foreign tables.
+ */
+typedef struct MySQLFdwRelationInfo
+{
+	/*
+	 * True means that the relation can be pushed down.  Always true for a
+	 * simple foreign scan.
+	 */
+	bool		pushdown_safe;
+
+	/*
+	 * Restriction clauses, broken down into safe and unsafe subsets.  Those
+	 * of a join are the clauses checked after it, in its WHERE clause.
+	 */
+	List	   *remote_conds;
+	List	   *local_conds;
+
+	/* Bitmap of attr numbers we need to fetch from the remote server. */
+	Bitmapset  *attrs_used;
+
+	/* Whether the scan may be executed asynchronously. */
+	bool		async_capable;
+
+	/* Integer primary key a parallel scan splits its work on, if any. */
+	char	   *parallel_key;
+	int			parallel_workers;
+
+	/*
+	 * Columns leading an index of the table, as MySQLIndexColumn, known
+	 * with use_remote_estimate only.
+	 */
+	List	   *index_columns;
+
+	/* What MySQL's EXPLAIN told, known with use_remote_estimate only. */
+	MySQLRemoteEstimate remote;
+
+	/* Options, server and user mapping the relation is read with. */
+	mysql_opt  *options;
+	ForeignServer *server;
+	UserMapping *user;
+
+	/* Connection planning asked MySQL on, NULL until it had to. */
+	MYSQL	   *conn;
+
+	/* Join information */
+	RelOptInfo *outerrel;
+	RelOptInfo *innerrel;
+	JoinType	jointype;
+	List	   *joinclauses;	/* conditions of the ON clause */
+
+#if PG_VERSION_NUM >= 90600
+	/* Upper planning stage of an upper relation, outerrel being its input */
+	UpperRelationKind stage;
+#endif
+
+	/* Target list of an upper relation, read from outerrel */
+	List	   *grouped_tlist;
+} MySQLFdwRelationInfo;
+
+/*
+ * A column leading an index of a MySQL table, which MySQL can look rows up
+ * or read them in order by.
+ */
+typedef struct MySQLIndexColumn
+{
+	char	   *name;			/* remote name of the column */
+	double		ndistinct;		/* its distinct values, 0 if unknown */
+} MySQLIndexColumn;
+
+/* Tables of a pushed down join are known to MySQL as r<rtindex> */
+#define MYSQL_REL_ALIAS_PREFIX	"r"
+
+#ifndef IS_JOIN_REL
+#define IS_JOIN_REL(rel)	((rel)->reloptkind == RELOPT_JOINREL)
+#endif
+
+#ifndef IS_UPPER_REL
+#if PG_VERSION_NUM >= 90600
+#define IS_UPPER_REL(rel)	((rel)->reloptkind == RELOPT_UPPER_REL)
+#else
+#define IS_UPPER_REL(rel)	false
+#endif
+#endif
+
 /* MySQL Column List */
 typedef struct MySQLColumn
 {
@@ -139,6 +529,7 @@ int ((*_mysql_options)(MYSQL *mysql,enum mysql_option option, const void *arg));
 int ((*_mysql_stmt_prepare)(MYSQL_STMT *stmt, const char *query, unsigned long length));
 int ((*_mysql_stmt_execute)(MYSQL_STMT *stmt));
 int ((*_mysql_stmt_fetch)(MYSQL_STMT *stmt));
+int ((*_mysql_stmt_fetch_column)(MYSQL_STMT *stmt, MYSQL_BIND *bind_arg, unsigned int column, unsigned long offset));
 int ((*_mysql_query)(MYSQL *mysql, const char *q));
 bool ((*_mysql_stmt_attr_set)(MYSQL_STMT *stmt, enum enum_stmt_attr_type attr_type, const void *attr));
 bool ((*_mysql_stmt_close)(MYSQL_STMT * stmt));
@@ -149,7 +540,7 @@ bool ((*_mysql_stmt_bind_result)(MYSQL_STMT *stmt, MYSQL_BIND * bnd));
 
 MYSQL_STMT	*((*_mysql_stmt_init)(MYSQL *mysql));
 MYSQL_RES	*((*_mysql_stmt_result_metadata)(MYSQL_STMT *stmt));
-int ((*_mysql_stmt_store_result)(MYSQL *mysql));
+int ((*_mysql_stmt_store_result)(MYSQL_STMT *stmt));
 MYSQL_ROW	((*_mysql_fetch_row)(MYSQL_RES *result));
 MYSQL_FIELD	*((*_mysql_fetch_field)(MYSQL_RES *result));
 MYSQL_FIELD	*((*_mysql_fetch_fields)(MYSQL_RES *result));
@@ -173,9 +564,21 @@ const char *((*_mysql_get_server_info)(MYSQL *mysql));
 int ((*_mysql_get_proto_info)(MYSQL *mysql));
 
 unsigned int ((*_mysql_stmt_errno)(MYSQL_STMT *stmt));
+const char *((*_mysql_stmt_error)(MYSQL_STMT *stmt));
 unsigned int ((*_mysql_errno)(MYSQL *mysql));
 unsigned int ((*_mysql_num_fields)(MYSQL_RES *result));
 unsigned int ((*_mysql_num_rows)(MYSQL_RES *result));
+const char *((*_mysql_character_set_name)(MYSQL *mysql));
+
+#ifdef MYSQL_FDW_NONBLOCK
+/* Non-blocking entry points, NULL when the library does not have them */
+int ((*_mysql_stmt_execute_start)(int *ret, MYSQL_STMT *stmt));
+int ((*_mysql_stmt_execute_cont)(int *ret, MYSQL_STMT *stmt, int status));
+int ((*_mysql_stmt_fetch_start)(int *ret, MYSQL_STMT *stmt));
+int ((*_mysql_stmt_fetch_cont)(int *ret, MYSQL_STMT *stmt, int status));
+my_socket ((*_mysql_get_socket)(MYSQL *mysql));
+unsigned int ((*_mysql_get_timeout_value)(const MYSQL *mysql));
+#endif
 
 
 /* option.c headers */
@@ -185,25 +588,58 @@ extern mysql_opt *mysql_get_options(Oid foreigntableid);
 /* depare.c headers */
 extern void mysql_deparse_select(StringInfo buf, PlannerInfo *root, RelOptInfo *baserel,
 							 Bitmapset *attrs_used, char *svr_table, List **retrieved_attrs, List *tlist);
+extern void mysql_deparse_rel_select(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
+							 List *tlist, List *pathkeys, List **retrieved_attrs, List **params);
 extern void mysql_deparse_insert(StringInfo buf, PlannerInfo *root, Index rtindex, Relation rel, List *targetAttrs);
 extern void mysql_deparse_update(StringInfo buf, PlannerInfo *root, Index rtindex, Relation rel, List *targetAttrs, char *attname);
 extern void mysql_deparse_delete(StringInfo buf, PlannerInfo *root, Index rtindex, Relation rel, char *name);
 extern void mysql_append_where_clause(StringInfo buf, PlannerInfo *root, RelOptInfo *baserel, List *exprs,
 							 bool is_first,List **params);
 extern void mysql_deparse_analyze(StringInfo buf, char *dbname, char *relname);
+extern void mysql_deparse_primary_key(StringInfo sql, char *dbname, char *relname);
+extern void mysql_deparse_key_bounds(StringInfo sql, char *dbname, char *relname, char *key);
+extern void mysql_append_key_range(StringInfo buf, char *key, bool is_first);
+extern void mysql_append_key_list(StringInfo buf, char *key, int nkeys, bool is_first);
+extern void mysql_deparse_index_columns(StringInfo sql, char *dbname, char *relname);
+extern char *mysql_get_column_name(Oid relid, int attnum);
+#if PG_VERSION_NUM >= 90600
+extern Expr *mysql_find_em_expr(EquivalenceClass *ec, RelOptInfo *rel);
+extern bool mysql_is_foreign_pathkey(PlannerInfo *root, RelOptInfo *rel, PathKey *pathkey);
+extern bool mysql_pathkey_null_order_differs(PlannerInfo *root, RelOptInfo *rel, PathKey *pathkey);
+extern void mysql_append_order_by_clause(StringInfo buf, PlannerInfo *root, RelOptInfo *rel,
+							 List *pathkeys);
+#endif
+#if PG_VERSION_NUM >= 120000
+extern bool mysql_is_foreign_limit(Node *node);
+#endif
 
 
 /* connection.c headers */
-MYSQL *mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt);
+MYSQL *mysql_get_connection(ForeignServer *server, UserMapping *user, mysql_opt *opt,
+							bool compress);
 MYSQL *mysql_connect(char *svr_address, char *svr_username, char *svr_password, char *svr_database,
 							 int svr_port, bool svr_sa, char *svr_init_command,
 							 char *ssl_key, char *ssl_cert, char *ssl_ca, char *ssl_capath,
-							 char *ssl_cipher);
+							 char *ssl_cipher, MySQLCompression compression,
+							 int compression_level);
 void  mysql_cleanup_connection(void);
 void mysql_rel_connection(MYSQL *conn);
+MySQLFdwExecState *mysql_get_pending_scan(MYSQL *conn);
+void mysql_set_pending_scan(MYSQL *conn, MySQLFdwExecState *festate);
+MySQLFdwExecState *mysql_get_streaming_scan(MYSQL *conn);
+void mysql_set_streaming_scan(MYSQL *conn, MySQLFdwExecState *festate);
+
+/* mysql_fdw.c headers */
+void mysql_finish_pending_fetch(MYSQL *conn);
 
 #if PG_VERSION_NUM < 110000 /* TupleDescAttr is defined from PG version 11 */ 
 	#define TupleDescAttr(tupdesc, i) ((tupdesc)->attrs[(i)])
 #endif
 
+#if PG_VERSION_NUM >= 130000 /* heap_open and heap_close are gone from PG version 13 */
+	#include "access/table.h"
+	#define heap_open(r, l) table_open(r, l)
+	#define heap_close(r, l) table_close(r, l)
+#endif
+
 #endif /* MYSQL_FDW_H */
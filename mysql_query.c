@@ -55,6 +55,7 @@
 #include "commands/vacuum.h"
 #include "foreign/fdwapi.h"
 #include "funcapi.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -85,6 +86,7 @@
 #include "storage/fd.h"
 #include "utils/builtins.h"
 #include "utils/datetime.h"
+#include "pgtime.h"
 
 
 #include "mysql_fdw.h"
@@ -103,66 +105,279 @@ x->second = y.tm_sec; \
 
 
 static int32 mysql_from_pgtyp(Oid type);
+static bool mysql_text_as_varlena(Oid pgtyp, MYSQL_FIELD *field);
+static enum enum_field_types mysql_native_type(Oid pgtyp, MYSQL_FIELD *field,
+											   unsigned long *size);
+static Datum mysql_time_to_datum(Oid pgtyp, MYSQL_TIME *t);
 static int dec_bin(int n);
 static int bin_dec(int n);
 
 
 /*
- * convert_mysql_to_pg: Convert MySQL data into PostgreSQL's compatible data types
+ * Converters used by mysql_convert_to_pg(), one per kind of bind buffer.
  */
-Datum
-mysql_convert_to_pg(Oid pgtyp, int pgtypmod, mysql_column *column)
+static Datum
+mysql_conv_bool(mysql_converter *conv, mysql_column *column)
+{
+	return BoolGetDatum(*((signed char *) column->value) != 0);
+}
+
+static Datum
+mysql_conv_int2(mysql_converter *conv, mysql_column *column)
+{
+	return Int16GetDatum(*((int16 *) column->value));
+}
+
+static Datum
+mysql_conv_int4(mysql_converter *conv, mysql_column *column)
+{
+	return Int32GetDatum(*((int32 *) column->value));
+}
+
+static Datum
+mysql_conv_int8(mysql_converter *conv, mysql_column *column)
+{
+	return Int64GetDatum(*((int64 *) column->value));
+}
+
+static Datum
+mysql_conv_float4(mysql_converter *conv, mysql_column *column)
+{
+	return Float4GetDatum(*((float4 *) column->value));
+}
+
+static Datum
+mysql_conv_float8(mysql_converter *conv, mysql_column *column)
+{
+	return Float8GetDatum(*((float8 *) column->value));
+}
+
+static Datum
+mysql_conv_time(mysql_converter *conv, mysql_column *column)
+{
+	return mysql_time_to_datum(conv->pgtype, (MYSQL_TIME *) column->value);
+}
+
+/*
+ * mysql_clip_value: Finish a value that was cut at max_blob_size, which is
+ * reported once per column and scan.
+ *
+ * The cut of text is moved back to the last whole character of the
+ * database encoding.  The text is checked to be in that encoding after
+ * this, where MySQL's conversion does not vouch for it, so a character
+ * split by the cut would otherwise fail the check.
+ */
+static void
+mysql_clip_value(mysql_converter *conv, mysql_column *column, const char *data)
+{
+	if (column->_mysql_bind->buffer_type == MYSQL_TYPE_VAR_STRING)
+		column->length = pg_mbcliplen(data, column->length, column->length);
+
+	if (!conv->warned)
+	{
+		ereport(WARNING,
+				(errmsg("value of result column %d was truncated to %lu bytes",
+						conv->attnum + 1, column->length),
+				 errhint("Raise or unset the max_blob_size option to fetch whole values.")));
+		conv->warned = true;
+	}
+}
+
+static Datum
+mysql_conv_bytea(mysql_converter *conv, mysql_column *column)
+{
+	bytea *result;
+
+	if (column->cut)
+		mysql_clip_value(conv, column, VARDATA(column->value));
+
+	/* A value fetched on its own is already a varlena of its own */
+	if (column->spill != (Datum) 0)
+	{
+		SET_VARSIZE(DatumGetPointer(column->value), column->length + VARHDRSZ);
+		return column->value;
+	}
+
+	/* The bind buffer is overwritten by the next fetch, so copy it out */
+	result = (bytea *) palloc(column->length + VARHDRSZ);
+	SET_VARSIZE(result, column->length + VARHDRSZ);
+	memcpy(VARDATA(result), VARDATA(column->value), column->length);
+	return PointerGetDatum(result);
+}
+
+/*
+ * MySQL gives BIT / BIT(n) data type as decimal value. The only way to
+ * retrieve this value is to use BIN, OCT or HEX function in MySQL, otherwise
+ * mysql client shows the actual decimal value, which could be a non - printable character.
+ * For exmple in MySQL
+ *
+ * CREATE TABLE t (b BIT(8));
+ * INSERT INTO t SET b = b'1001';
+ * SELECT BIN(b) FROM t;
+ * +--------+
+ * | BIN(b) |
+ * +--------+
+ * | 1001   |
+ * +--------+
+ *
+ * PostgreSQL expacts all binary data to be composed of either '0' or '1'. MySQL gives
+ * value 9 hence PostgreSQL reports error. The solution is to convert the decimal number
+ * into equivalent binary string.
+ */
+static Datum
+mysql_conv_bit(mysql_converter *conv, mysql_column *column)
 {
-	Datum value_datum = 0;
-	Datum valueDatum = 0;
-	regproc typeinput;
-	HeapTuple tuple;
-	int typemod;
 	char str[MAXDATELEN];
 
-	/* get the type's output function */
-	tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(pgtyp));
-	if (!HeapTupleIsValid(tuple))
-		elog(ERROR, "cache lookup failed for type%u", pgtyp);
+	sprintf(str, "%d", dec_bin(*((int*)column->value)));
+	conv->ncalls++;
+	return InputFunctionCall(&conv->typinput, str, conv->typioparam, conv->typmod);
+}
 
-	typeinput = ((Form_pg_type)GETSTRUCT(tuple))->typinput;
-	typemod  = ((Form_pg_type)GETSTRUCT(tuple))->typtypmod;
-	ReleaseSysCache(tuple);
+/*
+ * Text bound after a varlena header, see mysql_bind_result(): once the
+ * header is set the value is copied out whole, with no parsing.
+ */
+static Datum
+mysql_conv_varlena(mysql_converter *conv, mysql_column *column)
+{
+	Size  size;
+	void *result;
 
-	switch (pgtyp)
+	if (column->cut)
 	{
-		/*
-		 * MySQL gives BIT / BIT(n) data type as decimal value. The only way to
-		 * retrieve this value is to use BIN, OCT or HEX function in MySQL, otherwise
-		 * mysql client shows the actual decimal value, which could be a non - printable character.
-		 * For exmple in MySQL
-		 *
-		 * CREATE TABLE t (b BIT(8));
-		 * INSERT INTO t SET b = b'1001';
-		 * SELECT BIN(b) FROM t;
-		 * +--------+
-		 * | BIN(b) |
-		 * +--------+
-		 * | 1001   |
-		 * +--------+
-		 *
-		 * PostgreSQL expacts all binary data to be composed of either '0' or '1'. MySQL gives
-		 * value 9 hence PostgreSQL reports error. The solution is to convert the decimal number
-		 * into equivalent binary string.
-		 */
-		case BYTEAOID:
-			SET_VARSIZE(column->value, column->length + VARHDRSZ);
-			return PointerGetDatum(column->value);
+		mysql_clip_value(conv, column, VARDATA(column->value));
+
+		/* What is left of a JSON value is not JSON, have json_in say so */
+		if (conv->pgtype == JSONOID)
+		{
+			conv->ncalls++;
+			return InputFunctionCall(&conv->typinput,
+									 pnstrdup(VARDATA(column->value), column->length),
+									 conv->typioparam, conv->typmod);
+		}
+	}
+	size = column->length + VARHDRSZ;
+
+	/*
+	 * Text in the database encoding only needs the check for NUL bytes,
+	 * which MySQL allows in strings; finding one, the full check raises
+	 * the usual error.
+	 */
+	if (column->verify ||
+		memchr(VARDATA(column->value), '\0', column->length) != NULL)
+		pg_verify_mbstr(GetDatabaseEncoding(), VARDATA(column->value), column->length, false);
+
+	/* The bind buffer is overwritten by the next fetch, so copy it out */
+	SET_VARSIZE(DatumGetPointer(column->value), size);
+	if (column->spill != (Datum) 0)
+		return column->value;
+	result = palloc(size);
+	memcpy(result, DatumGetPointer(column->value), size);
+	return PointerGetDatum(result);
+}
+
+static Datum
+mysql_conv_text(mysql_converter *conv, mysql_column *column)
+{
+	if (column->cut)
+		mysql_clip_value(conv, column, (char *) column->value);
+
+	/* The bind buffer always has room for the terminator */
+	((char *) column->value)[column->length] = '\0';
+	conv->ncalls++;
+	return InputFunctionCall(&conv->typinput, (char *) column->value,
+							 conv->typioparam, conv->typmod);
+}
+
+/*
+ * mysql_init_converter: Pick the conversion routine for a column that has
+ * been bound by mysql_bind_result(), and resolve its input function.
+ *
+ * Returns the number of catalog lookups that were needed, so that the
+ * caller can report it.
+ */
+int
+mysql_init_converter(Oid pgtyp, mysql_column *column, mysql_converter *conv)
+{
+	HeapTuple tuple;
+	Form_pg_type typeform;
+
+	conv->pgtype = pgtyp;
+	conv->typmod = -1;
+	conv->typioparam = InvalidOid;
+	conv->ncalls = 0;
+	conv->warned = false;
+
+	switch (column->_mysql_bind->buffer_type)
+	{
+		case MYSQL_TYPE_TINY:
+			conv->convert = mysql_conv_bool;
+			return 0;
+
+		case MYSQL_TYPE_SHORT:
+			conv->convert = mysql_conv_int2;
+			return 0;
+
+		case MYSQL_TYPE_LONG:
+			conv->convert = mysql_conv_int4;
+			return 0;
+
+		case MYSQL_TYPE_LONGLONG:
+			conv->convert = mysql_conv_int8;
+			return 0;
+
+		case MYSQL_TYPE_FLOAT:
+			conv->convert = mysql_conv_float4;
+			return 0;
+
+		case MYSQL_TYPE_DOUBLE:
+			conv->convert = mysql_conv_float8;
+			return 0;
+
+		case MYSQL_TYPE_DATE:
+		case MYSQL_TYPE_TIME:
+		case MYSQL_TYPE_DATETIME:
+			conv->convert = mysql_conv_time;
+			return 0;
 
-		case BITOID:
-			sprintf(str, "%d", dec_bin(*((int*)column->value)));
-			valueDatum = CStringGetDatum((char*)str);
-		break;
 		default:
-			valueDatum = CStringGetDatum((char*)column->value);
+			break;
+	}
+
+	if (pgtyp == BYTEAOID)
+	{
+		conv->convert = mysql_conv_bytea;
+		return 0;
 	}
-	value_datum = OidFunctionCall3(typeinput, valueDatum, ObjectIdGetDatum(InvalidOid), Int32GetDatum(typemod));
-	return value_datum;
+
+	if (column->varlena)
+	{
+		Oid typinput;
+
+		/* JSON cut at max_blob_size still goes through json_in */
+		if (pgtyp == JSONOID)
+		{
+			getTypeInputInfo(pgtyp, &typinput, &conv->typioparam);
+			fmgr_info(typinput, &conv->typinput);
+		}
+		conv->convert = mysql_conv_varlena;
+		return 0;
+	}
+
+	/* Everything else goes through the type's input function */
+	tuple = SearchSysCache1(TYPEOID, ObjectIdGetDatum(pgtyp));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for type%u", pgtyp);
+
+	typeform = (Form_pg_type) GETSTRUCT(tuple);
+	fmgr_info(typeform->typinput, &conv->typinput);
+	conv->typioparam = getTypeIOParam(tuple);
+	conv->typmod = typeform->typtypmod;
+	ReleaseSysCache(tuple);
+
+	conv->convert = (pgtyp == BITOID) ? mysql_conv_bit : mysql_conv_text;
+	return 1;
 }
 
 
@@ -430,34 +645,482 @@ mysql_bind_sql_var(Oid type, int attnum, Datum value, MYSQL_BIND *binds, bool *i
 }
 
 
+/*
+ * mysql_native_type: Give the MySQL buffer type that a column of the given
+ * MySQL field type can be fetched into for the PG type, or MYSQL_TYPE_NULL
+ * if the value has to go through the text representation.
+ *
+ * Only lossless combinations are mapped; anything else (unsigned values
+ * wider than the PG type, DECIMAL, string columns, ...) keeps using the
+ * type's input function so that range and syntax errors are reported as
+ * before.
+ */
+static enum enum_field_types
+mysql_native_type(Oid pgtyp, MYSQL_FIELD *field, unsigned long *size)
+{
+	bool is_unsigned = (field->flags & UNSIGNED_FLAG) != 0;
+
+	switch (pgtyp)
+	{
+		case BOOLOID:
+			if (field->type == MYSQL_TYPE_TINY)
+			{
+				*size = sizeof(signed char);
+				return MYSQL_TYPE_TINY;
+			}
+			break;
+
+		case INT2OID:
+			if (field->type == MYSQL_TYPE_TINY ||
+				field->type == MYSQL_TYPE_YEAR ||
+				(field->type == MYSQL_TYPE_SHORT && !is_unsigned))
+			{
+				*size = sizeof(int16);
+				return MYSQL_TYPE_SHORT;
+			}
+			break;
+
+		case INT4OID:
+			if (field->type == MYSQL_TYPE_TINY ||
+				field->type == MYSQL_TYPE_SHORT ||
+				field->type == MYSQL_TYPE_INT24 ||
+				field->type == MYSQL_TYPE_YEAR ||
+				(field->type == MYSQL_TYPE_LONG && !is_unsigned))
+			{
+				*size = sizeof(int32);
+				return MYSQL_TYPE_LONG;
+			}
+			break;
+
+		case INT8OID:
+			if (field->type == MYSQL_TYPE_TINY ||
+				field->type == MYSQL_TYPE_SHORT ||
+				field->type == MYSQL_TYPE_INT24 ||
+				field->type == MYSQL_TYPE_LONG ||
+				field->type == MYSQL_TYPE_YEAR ||
+				(field->type == MYSQL_TYPE_LONGLONG && !is_unsigned))
+			{
+				*size = sizeof(int64);
+				return MYSQL_TYPE_LONGLONG;
+			}
+			break;
+
+		case FLOAT4OID:
+			if (field->type == MYSQL_TYPE_FLOAT)
+			{
+				*size = sizeof(float4);
+				return MYSQL_TYPE_FLOAT;
+			}
+			break;
+
+		case FLOAT8OID:
+			/*
+			 * A FLOAT widened to DOUBLE by the client library keeps its
+			 * binary noise (0.1 becomes 0.100000001490116), so only DOUBLE
+			 * is taken natively; FLOAT goes through its shortest text form.
+			 */
+			if (field->type == MYSQL_TYPE_DOUBLE)
+			{
+				*size = sizeof(float8);
+				return MYSQL_TYPE_DOUBLE;
+			}
+			break;
+
+		case DATEOID:
+			if (field->type == MYSQL_TYPE_DATE ||
+				field->type == MYSQL_TYPE_NEWDATE)
+			{
+				*size = sizeof(MYSQL_TIME);
+				return MYSQL_TYPE_DATE;
+			}
+			break;
+
+		case TIMEOID:
+			if (field->type == MYSQL_TYPE_TIME)
+			{
+				*size = sizeof(MYSQL_TIME);
+				return MYSQL_TYPE_TIME;
+			}
+			break;
+
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			if (field->type == MYSQL_TYPE_DATETIME ||
+				field->type == MYSQL_TYPE_TIMESTAMP ||
+				field->type == MYSQL_TYPE_DATE ||
+				field->type == MYSQL_TYPE_NEWDATE)
+			{
+				*size = sizeof(MYSQL_TIME);
+				return MYSQL_TYPE_DATETIME;
+			}
+			break;
+
+		default:
+			break;
+	}
+	return MYSQL_TYPE_NULL;
+}
+
+/*
+ * mysql_time_to_datum: Build a date, time or timestamp Datum from
+ * the MYSQL_TIME structure filled in by the client library.
+ */
+static Datum
+mysql_time_to_datum(Oid pgtyp, MYSQL_TIME *t)
+{
+	struct pg_tm tt, *tm = &tt;
+	fsec_t       fsec;
+
+	/*
+	 * MySQL happily stores zero dates such as '0000-00-00'; reject them the
+	 * same way the input functions would.
+	 */
+	if (pgtyp != TIMEOID &&
+		(t->month < 1 || t->month > MONTHS_PER_YEAR || t->day < 1 ||
+		 t->day > day_tab[isleap(t->year)][t->month - 1]))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+				 errmsg("date/time field value out of range: \"%04u-%02u-%02u\"",
+						t->year, t->month, t->day)));
+
+	switch (pgtyp)
+	{
+		case DATEOID:
+		{
+			if (!IS_VALID_JULIAN(t->year, t->month, t->day))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("date out of range: \"%04u-%02u-%02u\"",
+								t->year, t->month, t->day)));
+
+			return DateADTGetDatum(date2j(t->year, t->month, t->day) - POSTGRES_EPOCH_JDATE);
+		}
+		case TIMEOID:
+		{
+			TimeADT result;
+
+			if (t->neg || t->hour > HOURS_PER_DAY ||
+				(t->hour == HOURS_PER_DAY &&
+				 (t->minute > 0 || t->second > 0 || t->second_part > 0)))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("time out of range: \"%s%02u:%02u:%02u\"",
+								t->neg ? "-" : "", t->hour, t->minute, t->second)));
+
+#if PG_VERSION_NUM >= 100000 || defined(HAVE_INT64_TIMESTAMP)
+			result = ((((int64) t->hour * MINS_PER_HOUR + t->minute) * SECS_PER_MINUTE)
+					  + t->second) * USECS_PER_SEC + t->second_part;
+#else
+			result = ((t->hour * MINS_PER_HOUR + t->minute) * SECS_PER_MINUTE)
+					  + t->second + t->second_part / 1000000.0;
+#endif
+			return TimeADTGetDatum(result);
+		}
+		default:
+		{
+			Timestamp result;
+			int       tz;
+
+			memset(tm, 0, sizeof(struct pg_tm));
+			tm->tm_year = t->year;
+			tm->tm_mon = t->month;
+			tm->tm_mday = t->day;
+			tm->tm_hour = t->hour;
+			tm->tm_min = t->minute;
+			tm->tm_sec = t->second;
+#if PG_VERSION_NUM >= 100000 || defined(HAVE_INT64_TIMESTAMP)
+			fsec = t->second_part;
+#else
+			fsec = t->second_part / 1000000.0;
+#endif
+
+			/* MySQL hands out timestamps in the session time zone */
+			if (pgtyp == TIMESTAMPTZOID)
+			{
+				tz = DetermineTimeZoneOffset(tm, session_timezone);
+				if (tm2timestamp(tm, fsec, &tz, &result) != 0)
+					ereport(ERROR,
+							(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+							 errmsg("timestamp out of range")));
+			}
+			else if (tm2timestamp(tm, fsec, NULL, &result) != 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("timestamp out of range")));
+
+			return TimestampGetDatum(result);
+		}
+	}
+}
+
+/*
+ * mysql_result_buffer_size: Initial size of the bind buffer of a string
+ * or binary column.
+ *
+ * The metadata of the result set gives the longest value actually present
+ * when it is known, else the declared length of the column.  Large or
+ * unknown lengths start with a modest buffer that mysql_fetch_truncated()
+ * grows on demand.
+ */
+static unsigned long
+mysql_result_buffer_size(MYSQL_FIELD *field, unsigned long max_blob_size)
+{
+	unsigned long size;
+
+	size = field->max_length > 0 ? field->max_length : field->length;
+	size = Max(size, MYSQL_MIN_BUFFER);
+	size = Min(size, MYSQL_INIT_BUFFER);
+
+	if (max_blob_size > 0)
+		size = Min(size, max_blob_size);
+
+	return size;
+}
+
+/*
+ * mysql_text_as_varlena: Tell whether values of a result column can be
+ * taken as they are for the given type, so that they can be fetched right
+ * after a varlena header.
+ *
+ * The input functions of text, varchar and bpchar do nothing but copy
+ * the string, with the typmod they get from mysql_init_converter().  JSON
+ * needs parsing, unless MySQL vouches for it with its own JSON type; a
+ * value cut at max_blob_size is parsed all the same, see
+ * mysql_conv_varlena().
+ */
+static bool
+mysql_text_as_varlena(Oid pgtyp, MYSQL_FIELD *field)
+{
+	switch (pgtyp)
+	{
+		case TEXTOID:
+		case VARCHAROID:
+		case BPCHAROID:
+			return true;
+
+		case JSONOID:
+#if MYSQL_VERSION_ID >= 50708
+			return field->type == MYSQL_TYPE_JSON;
+#else
+			return false;
+#endif
+
+		default:
+			return false;
+	}
+}
+
 /*
  * mysql_bind_result: Bind the value and null pointers to get
- * the data from remote mysql table (SELECT)
+ * the data from remote mysql table (mysql => pg conversion)
+ *
+ * charset_match tells that the connection charset is the database
+ * encoding, so that text converted by MySQL need not be checked.
  */
 void
-mysql_bind_result(Oid pgtyp, int pgtypmod, MYSQL_FIELD *field, mysql_column *column)
+mysql_bind_result(Oid pgtyp, int pgtypmod, MYSQL_FIELD *field, mysql_column *column,
+				  unsigned long max_blob_size, bool charset_match)
 {
 	MYSQL_BIND *mbind = column->_mysql_bind;
+	enum enum_field_types native_type;
+	unsigned long native_size = 0;
+	unsigned long size;
+
 	mbind->is_null = &column->is_null;
 	mbind->length = &column->length;
 	mbind->error = &column->error;
 
+	/* Fixed-width types are fetched in their binary form when possible */
+	native_type = mysql_native_type(pgtyp, field, &native_size);
+	if (native_type != MYSQL_TYPE_NULL)
+	{
+		mbind->buffer_type = native_type;
+		column->value = (Datum) palloc0(native_size);
+		mbind->buffer = (void *) column->value;
+		mbind->buffer_length = native_size;
+		return;
+	}
+
+	size = mysql_result_buffer_size(field, max_blob_size);
+
+	/* Text that is taken as it is goes right after a varlena header */
+	if (mysql_text_as_varlena(pgtyp, field))
+	{
+		mbind->buffer_type = MYSQL_TYPE_VAR_STRING;
+		column->value = (Datum) palloc0(size + VARHDRSZ);
+		mbind->buffer = VARDATA(column->value);
+		mbind->buffer_length = size;
+		column->varlena = true;
+		/* Binary strings are sent as they are stored, whatever the charset */
+		column->verify = !charset_match || field->charsetnr == 63;
+		return;
+	}
+
 	switch (pgtyp)
 	{
 			case BYTEAOID:
 					mbind->buffer_type = MYSQL_TYPE_BLOB;
 					/* leave room at front for bytea buffer length prefix */
-					column->value = (Datum) palloc0(MAX_BLOB_WIDTH + VARHDRSZ);
+					column->value = (Datum) palloc0(size + VARHDRSZ);
 					mbind->buffer = VARDATA(column->value);
-					mbind->buffer_length = MAX_BLOB_WIDTH;
+					mbind->buffer_length = size;
+					column->varlena = true;
 					break;
 
 			default:
 					mbind->buffer_type = MYSQL_TYPE_VAR_STRING;
-					column->value = (Datum) palloc0(MAXDATALEN);
+					/* leave room at the end for the string terminator */
+					column->value = (Datum) palloc0(size + 1);
 					mbind->buffer = (char *) column->value;
-					mbind->buffer_length = MAXDATALEN;
+					mbind->buffer_length = size;
+	}
+}
+
+/*
+ * mysql_fetch_truncated: Fetch the part of a value of the current row
+ * that did not fit in the bind buffer of its column.
+ *
+ * The buffer is grown to hold the whole value, but never beyond
+ * max_blob_size when that is set: longer values are cut at that size, and
+ * column->cut is set so that the converter clips and reports them.
+ * *rebind is set when the buffer has moved, in which case the caller must
+ * bind the result again before fetching the next row.
+ *
+ * Values longer than MYSQL_MAX_BUFFER do not grow the buffer.  They are
+ * built in an allocation of their own, in the current memory context,
+ * which column->value points to until mysql_unspill_column() is called;
+ * the remainder is fetched MYSQL_FETCH_CHUNK bytes at a time.
+ *
+ * Returns false if MySQL failed to return the data.
+ */
+bool
+mysql_fetch_truncated(MYSQL_STMT *stmt, unsigned int colno, mysql_column *column,
+					  unsigned long max_blob_size, bool *rebind)
+{
+	MYSQL_BIND    *mbind = column->_mysql_bind;
+	unsigned long fetched = mbind->buffer_length;
+	unsigned long total = column->length;
+	unsigned long want = total;
+	char          *data;
+
+	/* Native buffers are sized for every value of their type */
+	if (mbind->buffer_type != MYSQL_TYPE_BLOB &&
+		mbind->buffer_type != MYSQL_TYPE_VAR_STRING)
+		ereport(ERROR,
+				(errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+				 errmsg("value of result column %u does not fit its PostgreSQL type", colno + 1)));
+
+	if (max_blob_size > 0 && want > max_blob_size)
+		want = max_blob_size;
+
+	if (want > MaxAllocSize - VARHDRSZ - 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("value of result column %u is too long: %lu bytes", colno + 1, total),
+				 errhint("Use the max_blob_size option to limit the size of fetched values.")));
+
+	if (want > MYSQL_MAX_BUFFER)
+	{
+		char          *value;
+		unsigned long offset;
+
+		if (column->varlena)
+		{
+			value = palloc(want + VARHDRSZ);
+			data = VARDATA(value);
+		}
+		else
+		{
+			value = palloc(want + 1);
+			data = value;
+		}
+
+		/* The leading part is in the buffer, the rest comes in chunks */
+		memcpy(data, mbind->buffer, fetched);
+		for (offset = fetched; offset < want; offset += MYSQL_FETCH_CHUNK)
+		{
+			MYSQL_BIND    rest;
+			unsigned long rest_length = 0;
+
+			CHECK_FOR_INTERRUPTS();
+
+			memset(&rest, 0, sizeof(MYSQL_BIND));
+			rest.buffer_type = mbind->buffer_type;
+			rest.buffer = data + offset;
+			rest.buffer_length = Min(want - offset, MYSQL_FETCH_CHUNK);
+			rest.length = &rest_length;
+			rest.is_null = &column->is_null;
+			rest.error = &column->error;
+
+			if (_mysql_stmt_fetch_column(stmt, &rest, colno, offset) != 0)
+				return false;
+		}
+
+		column->spill = column->value;
+		column->value = PointerGetDatum(value);
+	}
+	else if (want > fetched)
+	{
+		MYSQL_BIND    rest;
+		unsigned long rest_length = 0;
+		unsigned long capacity;
+
+		/* Grow geometrically, so that the following rows likely fit */
+		capacity = Max(want, fetched * 2);
+		capacity = Min(capacity, MYSQL_MAX_BUFFER);
+		if (max_blob_size > 0)
+			capacity = Min(capacity, max_blob_size);
+
+		if (column->varlena)
+		{
+			column->value = (Datum) repalloc((void *) column->value, capacity + VARHDRSZ);
+			mbind->buffer = VARDATA(column->value);
+		}
+		else
+		{
+			column->value = (Datum) repalloc((void *) column->value, capacity + 1);
+			mbind->buffer = (char *) column->value;
+		}
+		mbind->buffer_length = capacity;
+		*rebind = true;
+
+		/* The leading part is already in the buffer, fetch from there on */
+		memset(&rest, 0, sizeof(MYSQL_BIND));
+		rest.buffer_type = mbind->buffer_type;
+		rest.buffer = (char *) mbind->buffer + fetched;
+		rest.buffer_length = want - fetched;
+		rest.length = &rest_length;
+		rest.is_null = &column->is_null;
+		rest.error = &column->error;
+
+		if (_mysql_stmt_fetch_column(stmt, &rest, colno, fetched) != 0)
+			return false;
 	}
+
+	column->length = want;
+	column->error = false;
+
+	/* The converter clips and reports it, once the text is checked */
+	column->cut = want < total;
+
+	return true;
+}
+
+/*
+ * mysql_unspill_column: Point a column whose value was fetched on its own
+ * by mysql_fetch_truncated() back at its bind buffer.  The value itself
+ * belongs to the memory context it was fetched in.  This also forgets that
+ * the value was cut.
+ */
+void
+mysql_unspill_column(mysql_column *column)
+{
+	column->cut = false;
+	if (column->spill == (Datum) 0)
+		return;
+
+	column->value = column->spill;
+	column->spill = (Datum) 0;
 }
 
 static
@@ -26,8 +26,15 @@
 #include "utils/rel.h"
 
 
-Datum mysql_convert_to_pg(Oid pgtyp, int pgtypmod, mysql_column *column);
+/* Convert the value fetched into column using its precompiled converter */
+#define mysql_convert_to_pg(conv, column) ((conv)->convert((conv), (column)))
+
 void mysql_bind_sql_var(Oid type, int attnum, Datum value, MYSQL_BIND *binds, bool *isnull);
-void mysql_bind_result(Oid pgtyp, int pgtypmod, MYSQL_FIELD *field, mysql_column *column);
+void mysql_bind_result(Oid pgtyp, int pgtypmod, MYSQL_FIELD *field, mysql_column *column,
+					   unsigned long max_blob_size, bool charset_match);
+bool mysql_fetch_truncated(MYSQL_STMT *stmt, unsigned int colno, mysql_column *column,
+						   unsigned long max_blob_size, bool *rebind);
+void mysql_unspill_column(mysql_column *column);
+int mysql_init_converter(Oid pgtyp, mysql_column *column, mysql_converter *conv);
 
 #endif /* MYSQL_QUERY_H */
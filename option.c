@@ -18,6 +18,7 @@
 #include "mysql_fdw.h"
 
 #include <stdio.h>
+#include <math.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -71,6 +72,25 @@ static struct MySQLFdwOption valid_options[] =
 	{ "secure_auth",    ForeignServerRelationId },
 	{ "max_blob_size",  ForeignTableRelationId },
 	{ "use_remote_estimate",    ForeignServerRelationId },
+	{ "fetch_size",     ForeignServerRelationId },
+	{ "fetch_size",     ForeignTableRelationId },
+	{ "fetch_mode",     ForeignServerRelationId },
+	{ "fetch_mode",     ForeignTableRelationId },
+	{ "batch_size",     ForeignServerRelationId },
+	{ "batch_size",     ForeignTableRelationId },
+	{ "async_capable",  ForeignServerRelationId },
+	{ "async_capable",  ForeignTableRelationId },
+	{ "parallel_workers",   ForeignTableRelationId },
+	{ "lookup_batch_size",  ForeignServerRelationId },
+	{ "lookup_batch_size",  ForeignTableRelationId },
+	{ "compression",    ForeignServerRelationId },
+	{ "compression_level",  ForeignServerRelationId },
+	{ "compression_threshold",  ForeignServerRelationId },
+	{ "fdw_startup_cost",   ForeignServerRelationId },
+	{ "fdw_tuple_cost",     ForeignServerRelationId },
+	{ "fdw_byte_cost",      ForeignServerRelationId },
+	{ "rtt_ms",         ForeignServerRelationId },
+	{ "remote_cost_factor", ForeignServerRelationId },
 	{ "ssl_key",        ForeignServerRelationId },
 	{ "ssl_cert",       ForeignServerRelationId },
 	{ "ssl_ca",         ForeignServerRelationId },
@@ -83,6 +103,11 @@ static struct MySQLFdwOption valid_options[] =
 
 extern Datum mysql_fdw_validator(PG_FUNCTION_ARGS);
 
+static void mysql_parse_scan_options(List *options, mysql_opt *opt);
+static int mysql_parse_rows(DefElem *def, const char *hint);
+static int mysql_parse_size(DefElem *def, const char *hint);
+static double mysql_parse_cost(DefElem *def, const char *hint);
+
 PG_FUNCTION_INFO_V1(mysql_fdw_validator);
 
 
@@ -131,6 +156,10 @@ mysql_fdw_validator(PG_FUNCTION_ARGS)
 				));
 		}
 	}
+
+	/* Check the values of the options that need one of a given form */
+	mysql_parse_scan_options(options_list, NULL);
+
 	PG_RETURN_VOID();
 }
 
@@ -247,6 +276,18 @@ mysql_get_options(Oid foreignoid)
 			opt->ssl_cipher = defGetString(def);
 
 	}
+
+	/* Scan options set on the table take precedence over the server's */
+	opt->fetch_size = MYSQL_PREFETCH_ROWS;
+	opt->fetch_mode = MYSQL_FETCH_CURSOR;
+	opt->batch_size = MYSQL_BATCH_ROWS;
+	opt->fdw_startup_cost = MYSQL_STARTUP_COST;
+	opt->fdw_tuple_cost = MYSQL_TUPLE_COST;
+	opt->remote_cost_factor = MYSQL_REMOTE_COST_FACTOR;
+	mysql_parse_scan_options(f_server->options, opt);
+	if (f_table)
+		mysql_parse_scan_options(f_table->options, opt);
+
 	/* Default values, if required */
 	if (!opt->svr_address)
 		opt->svr_address = "127.0.0.1";
@@ -260,4 +301,256 @@ mysql_get_options(Oid foreignoid)
 	return opt;
 }
 
+/*
+ * mysql_parse_scan_options: Parse the options controlling how scans fetch
+ * their rows, if any, of an option list into opt.
+ *
+ * fetch_size is either a positive number of rows or "auto", which makes
+ * the scan grow its fetch size geometrically.  fetch_mode is one of
+ * "cursor", "buffered", "streaming" or "auto".  batch_size is a positive
+ * number of rows.  async_capable is a boolean.  parallel_workers is a
+ * positive number of workers.  lookup_batch_size is a number of keys from
+ * 1 to 65535.  compression is one of "none", "zlib" or
+ * "zstd", compression_level a zstd level from 1 to 22, and
+ * compression_threshold a number of kilobytes, which may be 0.  fdw_startup_cost,
+ * fdw_tuple_cost, fdw_byte_cost, rtt_ms and remote_cost_factor are
+ * numbers that are not negative.  opt may be NULL to only validate the values.
+ */
+static void
+mysql_parse_scan_options(List *options, mysql_opt *opt)
+{
+	ListCell *lc;
+
+	foreach(lc, options)
+	{
+		DefElem *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "fetch_size") == 0)
+		{
+			bool adaptive = (pg_strcasecmp(defGetString(def), "auto") == 0);
+			int  fetch_size = MYSQL_FETCH_MIN;
+
+			if (!adaptive)
+				fetch_size = mysql_parse_rows(def, "fetch_size must be a positive number of rows or \"auto\".");
+
+			if (opt)
+			{
+				opt->fetch_size = (unsigned long) fetch_size;
+				opt->fetch_adaptive = adaptive;
+			}
+		}
+		else if (strcmp(def->defname, "fetch_mode") == 0)
+		{
+			char           *value = defGetString(def);
+			MySQLFetchMode fetch_mode;
+
+			if (pg_strcasecmp(value, "cursor") == 0)
+				fetch_mode = MYSQL_FETCH_CURSOR;
+			else if (pg_strcasecmp(value, "buffered") == 0)
+				fetch_mode = MYSQL_FETCH_BUFFERED;
+			else if (pg_strcasecmp(value, "streaming") == 0)
+				fetch_mode = MYSQL_FETCH_STREAMING;
+			else if (pg_strcasecmp(value, "auto") == 0)
+				fetch_mode = MYSQL_FETCH_AUTO;
+			else
+				ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+					errmsg("invalid value for option \"%s\": \"%s\"", def->defname, value),
+					errhint("Valid values are: cursor, buffered, streaming, auto.")));
+
+			if (opt)
+				opt->fetch_mode = fetch_mode;
+		}
+		else if (strcmp(def->defname, "batch_size") == 0)
+		{
+			int batch_size = mysql_parse_rows(def, "batch_size must be a number of rows from 1 to 100000.");
+
+			/* The staging area holds the values of the whole batch */
+			if (batch_size > MYSQL_MAX_BATCH_ROWS)
+				ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+					errmsg("invalid value for option \"%s\": \"%s\"", def->defname, defGetString(def)),
+					errhint("batch_size must be a number of rows from 1 to 100000.")));
+
+			if (opt)
+				opt->batch_size = batch_size;
+		}
+		else if (strcmp(def->defname, "async_capable") == 0)
+		{
+			bool async_capable = defGetBoolean(def);
+
+			if (opt)
+				opt->async_capable = async_capable;
+		}
+		else if (strcmp(def->defname, "parallel_workers") == 0)
+		{
+			int parallel_workers = mysql_parse_rows(def, "parallel_workers must be a positive number.");
+
+			if (opt)
+				opt->parallel_workers = parallel_workers;
+		}
+		else if (strcmp(def->defname, "lookup_batch_size") == 0)
+		{
+			int lookup_batch_size = mysql_parse_rows(def, "lookup_batch_size must be a number of keys from 1 to 65535.");
+
+			/* Each key is a placeholder of the statement */
+			if (lookup_batch_size > MYSQL_MAX_LOOKUP_KEYS)
+				ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+					errmsg("invalid value for option \"%s\": \"%s\"", def->defname, defGetString(def)),
+					errhint("lookup_batch_size must be a number of keys from 1 to 65535.")));
+
+			if (opt)
+				opt->lookup_batch_size = lookup_batch_size;
+		}
+		else if (strcmp(def->defname, "compression") == 0)
+		{
+			char             *value = defGetString(def);
+			MySQLCompression compression;
+
+			if (pg_strcasecmp(value, "none") == 0)
+				compression = MYSQL_COMPRESS_NONE;
+			else if (pg_strcasecmp(value, "zlib") == 0)
+				compression = MYSQL_COMPRESS_ZLIB;
+			else if (pg_strcasecmp(value, "zstd") == 0)
+			{
+#ifndef MYSQL_FDW_ZSTD
+				ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+					errmsg("zstd compression is not supported by this MySQL client library"),
+					errhint("zstd needs the MySQL client library 8.0.18 or later, use zlib instead.")));
+#endif
+				compression = MYSQL_COMPRESS_ZSTD;
+			}
+			else
+				ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+					errmsg("invalid value for option \"%s\": \"%s\"", def->defname, value),
+					errhint("Valid values are: none, zlib, zstd.")));
+
+			if (opt)
+				opt->compression = compression;
+		}
+		else if (strcmp(def->defname, "compression_level") == 0)
+		{
+			int level = mysql_parse_rows(def, "compression_level must be a zstd level from 1 to 22.");
+
+			if (level > 22)
+				ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+					errmsg("invalid value for option \"%s\": \"%s\"", def->defname, defGetString(def)),
+					errhint("compression_level must be a zstd level from 1 to 22.")));
+
+			if (opt)
+				opt->compression_level = level;
+		}
+		else if (strcmp(def->defname, "compression_threshold") == 0)
+		{
+			int threshold = mysql_parse_size(def, "compression_threshold must be a number of kilobytes that is not negative.");
+
+			if (opt)
+				opt->compression_threshold = threshold;
+		}
+		else if (strcmp(def->defname, "fdw_startup_cost") == 0)
+		{
+			double cost = mysql_parse_cost(def, "fdw_startup_cost must be a number that is not negative.");
+
+			if (opt)
+				opt->fdw_startup_cost = cost;
+		}
+		else if (strcmp(def->defname, "fdw_tuple_cost") == 0)
+		{
+			double cost = mysql_parse_cost(def, "fdw_tuple_cost must be a number that is not negative.");
+
+			if (opt)
+				opt->fdw_tuple_cost = cost;
+		}
+		else if (strcmp(def->defname, "fdw_byte_cost") == 0)
+		{
+			double cost = mysql_parse_cost(def, "fdw_byte_cost must be a number that is not negative.");
+
+			if (opt)
+				opt->fdw_byte_cost = cost;
+		}
+		else if (strcmp(def->defname, "rtt_ms") == 0)
+		{
+			double rtt = mysql_parse_cost(def, "rtt_ms must be a number of milliseconds that is not negative.");
+
+			if (opt)
+				opt->rtt_ms = rtt;
+		}
+		else if (strcmp(def->defname, "remote_cost_factor") == 0)
+		{
+			double factor = mysql_parse_cost(def, "remote_cost_factor must be a number that is not negative.");
+
+			if (opt)
+				opt->remote_cost_factor = factor;
+		}
+	}
+}
+
+/*
+ * mysql_parse_rows: Parse the value of an option giving a positive number,
+ * such as a number of rows.
+ */
+static int
+mysql_parse_rows(DefElem *def, const char *hint)
+{
+	char *value = defGetString(def);
+	char *endp;
+	long rows;
+
+	errno = 0;
+	rows = strtol(value, &endp, 10);
+	if (errno != 0 || *endp != '\0' || endp == value || rows <= 0 || rows > INT_MAX)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+			errmsg("invalid value for option \"%s\": \"%s\"", def->defname, value),
+			errhint("%s", hint)));
+
+	return (int) rows;
+}
+
+/*
+ * mysql_parse_size: Parse the value of an option giving a number that is
+ * not negative, such as a size.
+ */
+static int
+mysql_parse_size(DefElem *def, const char *hint)
+{
+	char *value = defGetString(def);
+	char *endp;
+	long size;
+
+	errno = 0;
+	size = strtol(value, &endp, 10);
+	if (errno != 0 || *endp != '\0' || endp == value || size < 0 || size > INT_MAX)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+			errmsg("invalid value for option \"%s\": \"%s\"", def->defname, value),
+			errhint("%s", hint)));
+
+	return (int) size;
+}
 
+/*
+ * mysql_parse_cost: Parse the value of an option giving a number that is
+ * not negative, such as a cost.
+ */
+static double
+mysql_parse_cost(DefElem *def, const char *hint)
+{
+	char   *value = defGetString(def);
+	char   *endp;
+	double cost;
+
+	errno = 0;
+	cost = strtod(value, &endp);
+	if (errno != 0 || *endp != '\0' || endp == value || !(cost >= 0) || isinf(cost))
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_INVALID_ATTRIBUTE_VALUE),
+			errmsg("invalid value for option \"%s\": \"%s\"", def->defname, value),
+			errhint("%s", hint)));
+
+	return cost;
+}
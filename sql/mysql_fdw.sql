@@ -62,6 +62,156 @@ SELECT * FROM employee WHERE emp_id NOT IN (SELECT emp_id FROM employee WHERE em
 SELECT * FROM employee WHERE emp_name NOT IN ('emp - 1', 'emp - 2') LIMIT 5;
 SELECT * FROM employee WHERE emp_name NOT IN ('emp - 10') LIMIT 5;
 
+-- Joins of tables of one server are sent to MySQL
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT d.department_name, e.emp_name FROM department d JOIN employee e ON d.department_id = e.emp_dept_id WHERE e.emp_id < 4 ORDER BY e.emp_name;
+SELECT d.department_name, e.emp_name FROM department d JOIN employee e ON d.department_id = e.emp_dept_id WHERE e.emp_id < 4 ORDER BY e.emp_name;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT d.department_name, e.emp_name FROM department d LEFT JOIN employee e ON d.department_id = e.emp_dept_id AND e.emp_id < 99 WHERE d.department_id > 97 ORDER BY d.department_name, e.emp_name;
+SELECT d.department_name, e.emp_name FROM department d LEFT JOIN employee e ON d.department_id = e.emp_dept_id AND e.emp_id < 99 WHERE d.department_id > 97 ORDER BY d.department_name, e.emp_name;
+
+-- MySQL has no FULL JOIN, it is done here
+SET enable_mergejoin TO off;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT d.department_name, e.emp_name FROM (SELECT * FROM department WHERE department_id > 98) d FULL JOIN (SELECT * FROM employee WHERE emp_id > 97) e ON d.department_id = e.emp_dept_id ORDER BY d.department_name, e.emp_name;
+SELECT d.department_name, e.emp_name FROM (SELECT * FROM department WHERE department_id > 98) d FULL JOIN (SELECT * FROM employee WHERE emp_id > 97) e ON d.department_id = e.emp_dept_id ORDER BY d.department_name, e.emp_name;
+RESET enable_mergejoin;
+
+-- A join clause MySQL cannot check is checked on the joined rows
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT d.department_name, e.emp_name FROM department d JOIN employee e ON d.department_id = e.emp_dept_id AND e.emp_name <> 'emp - ' || d.department_id::text WHERE e.emp_id < 25 ORDER BY e.emp_name;
+SELECT d.department_name, e.emp_name FROM department d JOIN employee e ON d.department_id = e.emp_dept_id AND e.emp_name <> 'emp - ' || d.department_id::text WHERE e.emp_id < 25 ORDER BY e.emp_name;
+
+-- Tables of different servers are joined here
+CREATE SERVER mysql_svr2 FOREIGN DATA WRAPPER mysql_fdw;
+CREATE USER MAPPING FOR postgres SERVER mysql_svr2 OPTIONS(username 'foo', password 'bar');
+CREATE FOREIGN TABLE employee2(emp_id int, emp_name text, emp_dept_id int) SERVER mysql_svr2 OPTIONS(dbname 'testdb', table_name 'employee');
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT count(*) FROM department d, employee2 e WHERE d.department_id < 3 AND e.emp_id < 4;
+SELECT count(*) FROM department d, employee2 e WHERE d.department_id < 3 AND e.emp_id < 4;
+DROP FOREIGN TABLE employee2;
+DROP USER MAPPING FOR postgres SERVER mysql_svr2;
+DROP SERVER mysql_svr2;
+
+-- Aggregates MySQL computes alike are sent to it
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT count(*), sum(emp_id), min(emp_id), max(emp_id) FROM employee WHERE emp_id < 30;
+SELECT count(*), sum(emp_id), min(emp_id), max(emp_id) FROM employee WHERE emp_id < 30;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_dept_id, count(*) FROM employee WHERE emp_id < 6 GROUP BY emp_dept_id HAVING min(emp_id) > 4;
+SELECT emp_dept_id, count(*) FROM employee WHERE emp_id < 6 GROUP BY emp_dept_id HAVING min(emp_id) > 4;
+
+-- MySQL rounds the average of integers, so it is computed here
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT avg(emp_id) FROM employee WHERE emp_id < 30;
+SELECT avg(emp_id) FROM employee WHERE emp_id < 30;
+
+-- MySQL sorts NULLs first going up; other orders sort on IS NULL first
+INSERT INTO employee VALUES (101, 'emp - 101', NULL);
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id;
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id DESC;
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id DESC;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id NULLS FIRST;
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id NULLS FIRST;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id DESC NULLS LAST;
+SELECT emp_id, emp_dept_id FROM employee WHERE emp_id > 97 ORDER BY emp_dept_id DESC NULLS LAST;
+DELETE FROM employee WHERE emp_id = 101;
+
+-- LIMIT and OFFSET are applied by MySQL, which needs a LIMIT for an OFFSET
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id, emp_name FROM employee ORDER BY emp_id LIMIT 3 OFFSET 2;
+SELECT emp_id, emp_name FROM employee ORDER BY emp_id LIMIT 3 OFFSET 2;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id FROM employee ORDER BY emp_id OFFSET 97;
+SELECT emp_id FROM employee ORDER BY emp_id OFFSET 97;
+
+-- A nested loop looks its inner rows up with the values of the outer ones
+CREATE TABLE local_keys(id int, name text);
+INSERT INTO local_keys VALUES (5, 'emp - 5'), (20, 'Updated emp');
+ANALYZE local_keys;
+SET enable_hashjoin TO off;
+SET enable_mergejoin TO off;
+SET enable_material TO off;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT l.id, e.emp_name FROM local_keys l JOIN employee e ON e.emp_id = l.id;
+SELECT l.id, e.emp_name FROM local_keys l JOIN employee e ON e.emp_id = l.id;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT l.name, e.emp_id FROM local_keys l JOIN employee e ON e.emp_name = l.name;
+SELECT l.name, e.emp_id FROM local_keys l JOIN employee e ON e.emp_name = l.name;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET enable_material;
+DROP TABLE local_keys;
+
+-- Foreign scans are costed with the cost options of their server
+ALTER SERVER mysql_svr OPTIONS (ADD fdw_startup_cost '-1');
+ALTER SERVER mysql_svr OPTIONS (ADD fdw_tuple_cost 'cheap');
+ALTER SERVER mysql_svr OPTIONS (ADD fdw_byte_cost '-0.5');
+ALTER SERVER mysql_svr OPTIONS (ADD rtt_ms '-1');
+ALTER SERVER mysql_svr OPTIONS (ADD fdw_startup_cost '50', fdw_tuple_cost '0.02', fdw_byte_cost '0.001', rtt_ms '0.5');
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_id FROM employee WHERE emp_id = 1;
+SELECT emp_id FROM employee WHERE emp_id = 1;
+ALTER SERVER mysql_svr OPTIONS (DROP fdw_startup_cost, DROP fdw_tuple_cost, DROP fdw_byte_cost, DROP rtt_ms);
+
+-- mysql_fdw_calibrate measures rtt_ms and fdw_byte_cost and sets them
+SELECT * FROM mysql_fdw_calibrate('no_such_server');
+SELECT rtt_ms > 0 AS rtt_ms, fdw_byte_cost >= 0 AS fdw_byte_cost FROM mysql_fdw_calibrate('mysql_svr');
+SELECT option_name FROM pg_foreign_server, pg_options_to_table(srvoptions)
+  WHERE srvname = 'mysql_svr' AND option_name IN ('fdw_byte_cost', 'rtt_ms') ORDER BY 1;
+ALTER SERVER mysql_svr OPTIONS (DROP fdw_byte_cost, DROP rtt_ms);
+
+-- Row estimates of MySQL are kept for mysql_fdw.estimate_cache_ttl
+ALTER SERVER mysql_svr OPTIONS (ADD use_remote_estimate 'true');
+SELECT mysql_fdw_invalidate_estimates();
+EXPLAIN (COSTS OFF)
+SELECT emp_name FROM employee WHERE emp_id = 1;
+SELECT mysql_fdw_invalidate_estimates('mysql_svr');
+SELECT mysql_fdw_invalidate_estimates('mysql_svr');
+SELECT mysql_fdw_invalidate_estimates('no_such_server');
+SET mysql_fdw.estimate_cache_ttl = 0;
+EXPLAIN (COSTS OFF)
+SELECT emp_name FROM employee WHERE emp_id = 1;
+SELECT mysql_fdw_invalidate_estimates();
+RESET mysql_fdw.estimate_cache_ttl;
+EXPLAIN (COSTS OFF)
+SELECT emp_name FROM employee WHERE emp_id = 1;
+SELECT emp_name FROM employee WHERE emp_id = 1;
+
+-- Only superusers may forget the estimates of all sessions
+CREATE ROLE regress_mysql_fdw_user;
+SET ROLE regress_mysql_fdw_user;
+SELECT mysql_fdw_invalidate_estimates();
+RESET ROLE;
+DROP ROLE regress_mysql_fdw_user;
+SELECT mysql_fdw_invalidate_estimates();
+ALTER SERVER mysql_svr OPTIONS (DROP use_remote_estimate);
+
+-- MySQL's EXPLAIN tells how it reads the table, for a scan and for its lookups
+ALTER SERVER mysql_svr OPTIONS (ADD use_remote_estimate 'true');
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT emp_name FROM employee WHERE emp_id < 5;
+SELECT emp_name FROM employee WHERE emp_id < 5;
+CREATE TABLE local_keys(id int, name text);
+INSERT INTO local_keys VALUES (5, 'emp - 5'), (20, 'Updated emp');
+ANALYZE local_keys;
+SET enable_hashjoin TO off;
+SET enable_mergejoin TO off;
+SET enable_material TO off;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT l.id, e.emp_name FROM local_keys l JOIN employee e ON e.emp_id = l.id;
+SELECT l.id, e.emp_name FROM local_keys l JOIN employee e ON e.emp_id = l.id;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET enable_material;
+DROP TABLE local_keys;
+ALTER SERVER mysql_svr OPTIONS (DROP use_remote_estimate);
+
 create or replace function test_param_where() returns void as $$
 DECLARE
   n varchar;
@@ -82,6 +232,27 @@ create or replace function test_param_where2(integer, text) returns integer as '
 
 SELECT test_param_where2(1, 'One');
 
+ALTER SERVER mysql_svr OPTIONS (ADD fetch_size '0');
+ALTER SERVER mysql_svr OPTIONS (ADD fetch_size 'auto');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD fetch_size '2');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD batch_size '100001');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD batch_size '4');
+SELECT count(*) FROM numbers;
+ALTER FOREIGN TABLE numbers OPTIONS (ADD fetch_mode 'sometimes');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD fetch_mode 'buffered');
+SELECT count(*) FROM numbers;
+ALTER SERVER mysql_svr OPTIONS (ADD async_capable 'maybe');
+ALTER SERVER mysql_svr OPTIONS (ADD async_capable 'true');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD parallel_workers '0');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD parallel_workers '2');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD lookup_batch_size '0');
+ALTER FOREIGN TABLE numbers OPTIONS (ADD lookup_batch_size '70000');
+ALTER SERVER mysql_svr OPTIONS (ADD compression 'lz4');
+ALTER SERVER mysql_svr OPTIONS (ADD compression_level '23');
+ALTER SERVER mysql_svr OPTIONS (ADD compression_threshold '-1');
+ALTER SERVER mysql_svr OPTIONS (ADD compression 'zlib', compression_threshold '1024');
+ALTER SERVER mysql_svr OPTIONS (SET compression_threshold '0');
+
 DELETE FROM employee;
 DELETE FROM department;
 DELETE FROM empdata;